@@ -0,0 +1,196 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#if defined __cpp_exceptions || defined __EXCEPTIONS || defined _CPPUNWIND
+#   define CONSTEXPR_MAP_HAS_EXCEPTIONS
+#endif
+
+namespace LuaGlue {
+
+// constexpr string => V map using a perfect hash ("hash and displace")
+// Keys are hashed once with FNV-1a; the high bits select a bucket, which stores
+// a displacement that is mixed into the hash to get a collision-free slot.
+// Lookup is one string hash plus one string compare.
+// Construction happens at compile time when used in a constexpr context, so
+// there is no static initialization at runtime.
+
+// not constexpr: calling these during constant evaluation results in a compile error,
+// at runtime they throw std::logic_error, or abort without exceptions
+[[noreturn]] inline void constexpr_map_fail(const char *msg)
+{
+#ifdef CONSTEXPR_MAP_HAS_EXCEPTIONS
+    throw std::logic_error(msg);
+#else
+    fprintf(stderr, "%s\n", msg);
+    std::abort();
+#endif
+}
+
+[[noreturn]] inline void constexpr_map_duplicate_key()
+{
+    constexpr_map_fail("constexpr_map: duplicate key");
+}
+
+[[noreturn]] inline void constexpr_map_no_perfect_hash()
+{
+    constexpr_map_fail("constexpr_map: no perfect hash found");
+}
+
+template <class V, std::size_t N>
+class constexpr_map {
+    static_assert(N > 0, "constexpr_map needs at least one entry");
+    static_assert(N < 0xffff, "too many entries for constexpr_map");
+
+public:
+    using key_type = std::string_view;
+    using mapped_type = V;
+    using value_type = std::pair<std::string_view, V>;
+    using const_iterator = const value_type*;
+
+private:
+    static constexpr std::size_t next_pow2(std::size_t n)
+    {
+        std::size_t res = 1;
+        while (res < n)
+            res <<= 1;
+        return res;
+    }
+
+    static constexpr std::size_t SlotCount = next_pow2(N) * 2; // load factor <= 0.5
+    static constexpr std::size_t BucketCount = SlotCount < 4 ? 1 : SlotCount / 4; // <= 2 keys per bucket on average
+    static constexpr uint16_t EmptySlot = static_cast<uint16_t>(N);
+    static constexpr uint32_t MaxDisplacement = 0x10000;
+
+    std::array<value_type, N> _entries;
+    std::array<uint32_t, BucketCount> _disp{};
+    std::array<uint16_t, SlotCount> _index{};
+
+    static constexpr uint64_t hash(std::string_view s)
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (char c: s) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    static constexpr std::size_t bucket(uint64_t h)
+    {
+        return static_cast<std::size_t>(h >> 40) & (BucketCount - 1);
+    }
+
+    static constexpr std::size_t slot(uint64_t h, uint32_t d)
+    {
+        h ^= d * 0x9e3779b97f4a7c15ull;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return static_cast<std::size_t>(h) & (SlotCount - 1);
+    }
+
+    template <std::size_t... I>
+    constexpr constexpr_map(const value_type (&entries)[N], std::index_sequence<I...>)
+        : _entries{{entries[I]...}}
+    {
+        std::array<uint64_t, N> hashes{};
+        std::array<std::size_t, BucketCount> bucketSizes{};
+        std::size_t maxBucketSize = 0;
+        for (std::size_t i = 0; i < N; i++) {
+            hashes[i] = hash(_entries[i].first);
+            for (std::size_t j = 0; j < i; j++) {
+                if (hashes[i] == hashes[j])
+                    constexpr_map_duplicate_key(); // or a 64bit hash collision
+            }
+            const std::size_t n = ++bucketSizes[bucket(hashes[i])];
+            if (n > maxBucketSize)
+                maxBucketSize = n;
+        }
+        for (auto& index: _index)
+            index = EmptySlot;
+        // place biggest buckets first, they are the hardest to fit
+        for (std::size_t size = maxBucketSize; size > 0; size--) {
+            for (std::size_t b = 0; b < BucketCount; b++) {
+                if (bucketSizes[b] != size)
+                    continue;
+                for (uint32_t d = 0; ; d++) {
+                    if (d == MaxDisplacement)
+                        constexpr_map_no_perfect_hash();
+                    bool ok = true;
+                    for (std::size_t i = 0; i < N && ok; i++) {
+                        if (bucket(hashes[i]) != b)
+                            continue;
+                        auto& index = _index[slot(hashes[i], d)];
+                        if (index != EmptySlot)
+                            ok = false;
+                        else
+                            index = static_cast<uint16_t>(i);
+                    }
+                    if (ok) {
+                        _disp[b] = d;
+                        break;
+                    }
+                    // undo partial placement
+                    for (std::size_t i = 0; i < N; i++) {
+                        if (bucket(hashes[i]) != b)
+                            continue;
+                        auto& index = _index[slot(hashes[i], d)];
+                        if (index == i)
+                            index = EmptySlot;
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    constexpr constexpr_map(const value_type (&entries)[N])
+        : constexpr_map(entries, std::make_index_sequence<N>{})
+    {
+    }
+
+    constexpr const_iterator find(std::string_view key) const
+    {
+        const uint64_t h = hash(key);
+        const uint16_t i = _index[slot(h, _disp[bucket(h)])];
+        if (i != EmptySlot && _entries[i].first == key)
+            return &_entries[i];
+        return end();
+    }
+
+    constexpr std::size_t count(std::string_view key) const
+    {
+        return find(key) != end() ? 1 : 0;
+    }
+
+    constexpr const_iterator begin() const
+    {
+        return _entries.data();
+    }
+
+    constexpr const_iterator end() const
+    {
+        return _entries.data() + N;
+    }
+
+    constexpr std::size_t size() const
+    {
+        return N;
+    }
+};
+
+template <class V, std::size_t N>
+constexpr constexpr_map<V, N> make_constexpr_map(const std::pair<std::string_view, V> (&entries)[N])
+{
+    return constexpr_map<V, N>(entries);
+}
+
+} // namespace LuaGlue
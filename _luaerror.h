@@ -0,0 +1,112 @@
+#pragma once
+
+#ifndef _LUAGLUE_LUAMETHOD_H
+#error "Please include luamethod.h instead"
+#endif
+
+#include <cstring>
+#include <string>
+#include "lua_include.h"
+#include "luacompat.h"
+
+// non-raising argument checks and error messages for LuaMethodHelper
+// the error message is pushed and RaiseError is returned through the helpers, so LuaMethod::Call can raise it
+// with lua_error after all C++ arguments and results went out of scope. Yields are deferred the same way.
+
+namespace LuaGlue {
+
+// returned instead of the number of results when an error message was pushed
+constexpr int RaiseError = -1;
+
+// returned as Yield - count instead of the number of results to yield count values, see LuaYield
+constexpr int Yield = -2;
+
+inline int yield_results(int count)
+{
+    return Yield - count;
+}
+
+// yields the values returned as yield_results(count), must be the return expression of the lua_CFunction
+inline int yield(lua_State *L, int count)
+{
+    if (!lua_isyieldable(L))
+        return luaL_error(L, "attempt to yield from outside a coroutine");
+    return lua_yield(L, count);
+}
+
+// pushes message with position information, like luaL_error
+inline int push_error(lua_State *L, const char *msg, size_t len)
+{
+    luaL_where(L, 1);
+    lua_pushlstring(L, msg, len);
+    lua_concat(L, 2);
+    return RaiseError;
+}
+
+inline int push_error(lua_State *L, const std::string& msg)
+{
+    return push_error(L, msg.c_str(), msg.size());
+}
+
+// pushes the same message as luaL_argerror
+inline int push_arg_error(lua_State *L, int arg, const char *extramsg)
+{
+    lua_Debug ar;
+    luaL_where(L, 1);
+    if (!lua_getstack(L, 0, &ar)) {
+        lua_pushfstring(L, "bad argument #%d (%s)", arg, extramsg);
+    } else {
+        lua_getinfo(L, "n", &ar);
+        if (ar.namewhat && strcmp(ar.namewhat, "method") == 0)
+            arg--; // do not count self
+        lua_pushfstring(L, "bad argument #%d to '%s' (%s)", arg, ar.name ? ar.name : "?", extramsg);
+    }
+    lua_concat(L, 2);
+    return RaiseError;
+}
+
+// pushes the same message as luaL_typeerror
+inline int push_type_error(lua_State *L, int arg, const char *tname)
+{
+    const char *msg = lua_pushfstring(L, "%s expected, got %s", tname, luaL_typename(L, arg));
+    push_arg_error(L, arg, msg);
+    lua_remove(L, -2);
+    return RaiseError;
+}
+
+// same as luaL_checkinteger, but pushes the error instead of raising it
+inline bool check_integer(lua_State *L, int arg, lua_Integer& out)
+{
+    int isnum;
+    out = lua_tointegerx(L, arg, &isnum);
+    if (isnum)
+        return true;
+    if (lua_isnumber(L, arg))
+        push_arg_error(L, arg, "number has no integer representation");
+    else
+        push_type_error(L, arg, "number");
+    return false;
+}
+
+// same as luaL_checknumber, but pushes the error instead of raising it
+inline bool check_number(lua_State *L, int arg, lua_Number& out)
+{
+    int isnum;
+    out = lua_tonumberx(L, arg, &isnum);
+    if (isnum)
+        return true;
+    push_type_error(L, arg, "number");
+    return false;
+}
+
+// same as luaL_checklstring, but pushes the error instead of raising it
+inline bool check_string(lua_State *L, int arg, const char*& out, size_t& len)
+{
+    out = lua_tolstring(L, arg, &len);
+    if (out)
+        return true;
+    push_type_error(L, arg, "string");
+    return false;
+}
+
+} // namespace LuaGlue
@@ -4,15 +4,27 @@
 #error "Please include luamethod.h instead"
 #endif
 
+#include <cstring>
+#include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include "lua_include.h"
 #include "luapp.h" // provides function overloading for push
 #include "luaref.h" // provides reference for lua references (functions, ...)
 #include "luavariant.h"
+#include "luavarargs.h" // remaining arguments as view
 #include "lua_utils.h" // wraps (most) possible lua results
 #ifndef NO_LUAMETHOD_JSON
 #include "lua_json.h"
 #endif
+#include "luaresult.h" // LuaResult return values
+#include "luayield.h" // LuaYield return values
 #include "_return_type.h"
+#include "_luaerror.h" // non-raising argument checks
 
 #if defined __cpp_exceptions || defined __EXCEPTIONS || defined _CPPUNWIND
 #   define LUAMETHOD_HAS_EXCEPTIONS
@@ -31,24 +43,134 @@
 
 // LUA_METHOD: helper to generate a map name => func pointer
 // (Tracker, AddItems, const char*) => {"AddItems", LuaMethod<Tracker, &Tracker::AddItems,const char*>::Func}
-// TODO: (argument count to) allow overloads?
+// see _luaoverloads.h for LUA_OVERLOADS
 #define LUA_METHOD(CLASS, METHOD, ...) { STRINGIFY(METHOD), LuaMethod<CLASS,decltype(&CLASS::METHOD),&CLASS::METHOD,__VA_ARGS__>::Func }
 
+// LUA_FUNCTION: helper to generate a map name => func pointer for free functions, see LuaGlue::setfuncs
+// (parse, const char*) => {"parse", LuaFunction<decltype(&parse), &parse, const char*>::Func}
+// LUA_STATIC_METHOD: same for static member functions
+#define LUA_FUNCTION(FUNC, ...) { STRINGIFY(FUNC), LuaFunction<decltype(&FUNC),&FUNC,__VA_ARGS__>::Func }
+#define LUA_STATIC_METHOD(CLASS, METHOD, ...) { STRINGIFY(METHOD), LuaFunction<decltype(&CLASS::METHOD),&CLASS::METHOD,__VA_ARGS__>::Func }
+
+// LUA_PROPERTY: helpers to generate a map name => getter/setter for LuaInterface::MakePropertyMap
+// LUA_PROPERTY: read/write data member, (Tracker, name) => {"name", {get name, set name}}
+// LUA_PROPERTY_READONLY: read-only data member
+// LUA_PROPERTY_GETSET: getter method without args and setter method with one arg of type TYPE
+// LUA_PROPERTY_GET: read-only property from a getter method
+#define LUA_PROPERTY(CLASS, MEMBER) { STRINGIFY(MEMBER), { LuaMemberProperty<CLASS,decltype(&CLASS::MEMBER),&CLASS::MEMBER>::Get, \
+                                                           LuaMemberProperty<CLASS,decltype(&CLASS::MEMBER),&CLASS::MEMBER>::Set } }
+#define LUA_PROPERTY_READONLY(CLASS, MEMBER) { STRINGIFY(MEMBER), { LuaMemberProperty<CLASS,decltype(&CLASS::MEMBER),&CLASS::MEMBER>::Get, \
+                                                                    nullptr } }
+#define LUA_PROPERTY_GETSET(CLASS, NAME, GETTER, SETTER, TYPE) { STRINGIFY(NAME), { \
+        LuaPropertyGetter<CLASS,decltype(&CLASS::GETTER),&CLASS::GETTER>::Get, \
+        LuaPropertySetter<CLASS,decltype(&CLASS::SETTER),&CLASS::SETTER,TYPE>::Set } }
+#define LUA_PROPERTY_GET(CLASS, NAME, GETTER) { STRINGIFY(NAME), { \
+        LuaPropertyGetter<CLASS,decltype(&CLASS::GETTER),&CLASS::GETTER>::Get, nullptr } }
+
+namespace LuaGlue {
+
+// std::invoke for member function pointers and function pointers taking the object as first arg
+template <class FT, class T, class... Args>
+auto invoke(FT f, T *o, Args&&... args) -> decltype((o->*f)(std::forward<Args>(args)...))
+{
+    return (o->*f)(std::forward<Args>(args)...);
+}
+
+template <class FT, class T, class... Args>
+auto invoke(FT f, T *o, Args&&... args) -> decltype(f(o, std::forward<Args>(args)...))
+{
+    return f(o, std::forward<Args>(args)...);
+}
+
+// functions without object, see LuaFunction
+template <class FT, class... Args>
+auto invoke(FT f, void *, Args&&... args) -> decltype(f(std::forward<Args>(args)...))
+{
+    return f(std::forward<Args>(args)...);
+}
+
+// pushes a single result value, json is converted to tables
+template <typename V>
+void push_result(lua_State *L, const V& v)
+{
+    Lua(L).Push(v);
+}
+
+#ifndef NO_LUAMETHOD_JSON
+inline void push_result(lua_State *L, const json& v)
+{
+    json_to_lua(L, v);
+}
+#endif
+
+// pushes the elements of a tuple or pair, returns the number of values pushed or RaiseError
+template <typename Tuple, std::size_t... I>
+int push_tuple(lua_State *L, const Tuple& t, std::index_sequence<I...>)
+{
+    if (!lua_checkstack(L, (int)sizeof...(I)))
+        return push_error(L, "too many results");
+    int dummy[] = {0, (push_result(L, std::get<I>(t)), 0)...};
+    (void)dummy;
+    return (int)sizeof...(I);
+}
+
+// pushes the value of a successful LuaResult, returns the number of values pushed or RaiseError
+inline int push_results(lua_State *, const LuaResult<void>&)
+{
+    return 0;
+}
+
+template <typename V>
+typename std::enable_if<is_tuple<V>::value, int>::type
+push_results(lua_State *L, const LuaResult<V>& res)
+{
+    return push_tuple(L, res.value(), std::make_index_sequence<std::tuple_size<V>::value>());
+}
+
+template <typename V>
+typename std::enable_if<!is_tuple<V>::value, int>::type
+push_results(lua_State *L, const LuaResult<V>& res)
+{
+    push_result(L, res.value());
+    return 1;
+}
+
+} // namespace LuaGlue
+
 // recursive helper. Types of already fetched args in class template,
 //   Types of missing args in function template
 template <class T, class FT, FT F, typename... Prev>
 struct LuaMethodHelper
 {
+    // the fetched args are passed down by reference and only moved into F's parameters here,
+    //   they stay lvalues if F takes one of them by non-const reference
+    template <class FF = FT>
+    static auto invoke(int, T *o, Prev&... prev) -> decltype(LuaGlue::invoke(static_cast<FF>(F), o, std::forward<Prev>(prev)...))
+    {
+        return LuaGlue::invoke(F, o, std::forward<Prev>(prev)...);
+    }
+
+    template <class FF = FT>
+    static auto invoke(long, T *o, Prev&... prev) -> decltype(LuaGlue::invoke(static_cast<FF>(F), o, prev...))
+    {
+        return LuaGlue::invoke(F, o, prev...);
+    }
+
+    template <class FF = FT>
+    static auto call(T *o, Prev&... prev) -> decltype(invoke<FF>(0, o, prev...))
+    {
+        return invoke<FF>(0, o, prev...);
+    }
+
     template <typename Next, typename... Rest>
     static typename std::enable_if<std::is_same<Next, int>::value, int>::type
-    get(lua_State *L, T *o, int n, Prev... prev)
+    get(lua_State *L, T *o, int n, Prev&... prev)
     {
         // NOTE: we just default to 0 for optional args at the moment
-        int next;
-        if (n > lua_gettop(L))
-            next = 0;
-        else
-            next = (int)luaL_checkinteger(L, n);
+        lua_Integer value = 0;
+        if (n <= lua_gettop(L) && !LuaGlue::check_integer(L, n, value))
+            return LuaGlue::RaiseError;
+        int next = (int)value;
         LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d %d (%zu done, %zu remaining)\n",
                 n, next, sizeof...(Prev), sizeof...(Rest));
         n++;
@@ -57,15 +179,19 @@ struct LuaMethodHelper
 
     template <typename Next, typename... Rest>
     static typename std::enable_if<std::is_same<Next, unsigned>::value, int>::type
-    get(lua_State *L, T *o, int n, Prev... prev)
+    get(lua_State *L, T *o, int n, Prev&... prev)
     {
-        unsigned next;
-        if (n > lua_gettop(L))
-            next = 0;
-        else if (lua_isinteger(L, n))
+        unsigned next = 0;
+        if (n > lua_gettop(L)) {
+            // default
+        } else if (lua_isinteger(L, n)) {
             next = (unsigned)lua_tointeger(L, n);
-        else
-            next = (unsigned)luaL_checknumber(L, n);
+        } else {
+            lua_Number value;
+            if (!LuaGlue::check_number(L, n, value))
+                return LuaGlue::RaiseError;
+            next = (unsigned)value;
+        }
         LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d %u (%zu done, %zu remaining)\n",
                 n, next, sizeof...(Prev), sizeof...(Rest));
         n++;
@@ -74,33 +200,119 @@ struct LuaMethodHelper
 
     template <typename Next, typename... Rest>
     static typename std::enable_if<std::is_same<Next, int64_t>::value, int>::type
-    get(lua_State *L, T *o, int n, Prev... prev)
+    get(lua_State *L, T *o, int n, Prev&... prev)
     {
         int64_t next;
-        if (lua_isinteger(L, n))
+        if (lua_isinteger(L, n)) {
             next = (int64_t)lua_tointeger(L, n);
-        else
-            next = (int64_t)luaL_checknumber(L, n);
+        } else {
+            lua_Number value;
+            if (!LuaGlue::check_number(L, n, value))
+                return LuaGlue::RaiseError;
+            next = (int64_t)value;
+        }
         LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d %lld (%zu done, %zu remaining)\n",
                 n, (long long)next, sizeof...(Prev), sizeof...(Rest));
         n++;
         return LuaMethodHelper<T, FT, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
     }
 
+    template <typename Next, typename... Rest>
+    static typename std::enable_if<std::is_same<Next, double>::value, int>::type
+    get(lua_State *L, T *o, int n, Prev&... prev)
+    {
+        lua_Number value = 0;
+        if (n <= lua_gettop(L) && !LuaGlue::check_number(L, n, value))
+            return LuaGlue::RaiseError;
+        double next = (double)value;
+        LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d %g (%zu done, %zu remaining)\n",
+                n, next, sizeof...(Prev), sizeof...(Rest));
+        n++;
+        return LuaMethodHelper<T, FT, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
+    }
+
+    template <typename Next, typename... Rest>
+    static typename std::enable_if<std::is_same<Next, bool>::value, int>::type
+    get(lua_State *L, T *o, int n, Prev&... prev)
+    {
+        // Lua truthiness, missing args are false
+        bool next = lua_toboolean(L, n) != 0;
+        LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d %d (%zu done, %zu remaining)\n",
+                n, (int)next, sizeof...(Prev), sizeof...(Rest));
+        n++;
+        return LuaMethodHelper<T, FT, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
+    }
+
     template <typename Next, typename... Rest>
     static typename std::enable_if<std::is_same<Next, const char*>::value, int>::type
-    get(lua_State *L, T *o, int n, Prev... prev)
+    get(lua_State *L, T *o, int n, Prev&... prev)
     {
-        const char* next = luaL_checkstring(L, n);
+        const char* next;
+        size_t len;
+        if (!LuaGlue::check_string(L, n, next, len))
+            return LuaGlue::RaiseError;
         LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d \"%s\" (%zu done, %zu remaining)\n",
                 n, next, sizeof...(Prev), sizeof...(Rest));
         n++;
         return LuaMethodHelper<T, FT, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
     }
 
+#if __cplusplus >= 201703L
+    template <typename Next, typename... Rest>
+    static typename std::enable_if<std::is_same<Next, std::string_view>::value, int>::type
+    get(lua_State *L, T *o, int n, Prev&... prev)
+    {
+        // points into the Lua string, which is kept alive by the stack during the call
+        const char* s;
+        size_t len;
+        if (!LuaGlue::check_string(L, n, s, len))
+            return LuaGlue::RaiseError;
+        std::string_view next(s, len);
+        LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d \"%.*s\" (%zu done, %zu remaining)\n",
+                n, (int)next.size(), next.data(), sizeof...(Prev), sizeof...(Rest));
+        n++;
+        return LuaMethodHelper<T, FT, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
+    }
+#endif
+
+    template <typename Next, typename... Rest>
+    static typename std::enable_if<std::is_same<Next, lua_State*>::value, int>::type
+    get(lua_State *L, T *o, int n, Prev&... prev)
+    {
+        // calling thread, which is the coroutine if called from one. does not take a Lua argument
+        lua_State *next = L;
+        LUAMETHOD_DEBUG_printf("LuaMethod fetched: lua_State (%zu done, %zu remaining)\n",
+                sizeof...(Prev), sizeof...(Rest));
+        return LuaMethodHelper<T, FT, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
+    }
+
+    template <typename Next, typename... Rest>
+    static typename std::enable_if<std::is_same<Next, Lua&>::value || std::is_same<Next, Lua>::value, int>::type
+    get(lua_State *L, T *o, int n, Prev&... prev)
+    {
+        // same for the wrapper, lives until the method returns
+        Lua next(L);
+        LUAMETHOD_DEBUG_printf("LuaMethod fetched: Lua (%zu done, %zu remaining)\n",
+                sizeof...(Prev), sizeof...(Rest));
+        return LuaMethodHelper<T, FT, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
+    }
+
+    template <typename Next, typename... Rest>
+    static typename std::enable_if<std::is_same<Next, LuaVarArgs>::value, int>::type
+    get(lua_State *L, T *o, int n, Prev&... prev)
+    {
+        static_assert(sizeof...(Rest) == 0, "LuaVarArgs has to be the last argument");
+        // everything up to the top of the stack, may be empty
+        LuaVarArgs next = LuaVarArgs::FromStack(L, n);
+        LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d %zu varargs (%zu done)\n",
+                n, next.size(), sizeof...(Prev));
+        n += (int)next.size();
+        return LuaMethodHelper<T, FT, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
+    }
+
     template <typename Next, typename... Rest>
     static typename std::enable_if<std::is_same<Next, LuaRef>::value, int>::type
-    get(lua_State *L, T *o, int n, Prev... prev)
+    get(lua_State *L, T *o, int n, Prev&... prev)
     {
             lua_pushvalue(L, n); // make copy on top of stack
             LuaRef next;
@@ -113,7 +325,7 @@ struct LuaMethodHelper
 
     template <typename Next, typename... Rest>
     static typename std::enable_if<std::is_same<Next, LuaVariant>::value, int>::type
-    get(lua_State *L, T *o, int n, Prev... prev)
+    get(lua_State *L, T *o, int n, Prev&... prev)
     {
             LuaVariant next;
             next.Lua_Get(L,n);
@@ -126,7 +338,7 @@ struct LuaMethodHelper
 #ifndef NO_LUAMETHOD_JSON
     template <typename Next, typename... Rest>
     static typename std::enable_if<std::is_same<Next, json>::value, int>::type
-    get(lua_State *L, T *o, int n, Prev... prev)
+    get(lua_State *L, T *o, int n, Prev&... prev)
     {
         json next = lua_to_json(L, n);
         LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d json %s (%zu done, %zu remaining)\n",
@@ -138,7 +350,7 @@ struct LuaMethodHelper
 
     template <typename... Rest>
     static typename std::enable_if<sizeof...(Rest) != 0, int>::type
-    run(lua_State *L, T *o, int n, Prev... prev)
+    run(lua_State *L, T *o, int n, Prev&... prev)
     {
         // more args to be retrieved
         return LuaMethodHelper<T, FT, F, Prev...>::template get<Rest...>(L,o,n, prev...);
@@ -146,10 +358,10 @@ struct LuaMethodHelper
 
     template <typename... Rest>
     static typename std::enable_if<sizeof...(Rest) == 0 && std::is_same<LuaGlue::return_type_t<decltype(F)>, void>::value, int>::type
-    run(lua_State *L, T *o, int n, Prev... prev)
+    run(lua_State *, T *o, int, Prev&... prev)
     {
         // result is void
-        (o->*F)(prev...);
+        call(o, prev...);
         LUAMETHOD_DEBUG_printf("LuaMethod return void\n");
         return 0;
     }
@@ -157,26 +369,73 @@ struct LuaMethodHelper
 #ifndef NO_LUAMETHOD_JSON
     template <typename... Rest>
     static typename std::enable_if<sizeof...(Rest) == 0 && std::is_same<LuaGlue::return_type_t<decltype(F)>, json>::value, int>::type
-    run(lua_State *L, T *o, int n, Prev... prev)
+    run(lua_State *L, T *o, int, Prev&... prev)
     {
         // result is json
-        auto res = (o->*F)(prev...);
+        auto res = call(o, prev...);
         json_to_lua(L, res);
         LUAMETHOD_DEBUG_printf("LuaMethod pushed json: %s\n", res.dump().c_str());
         return 1;
     }
 #endif
 
+    template <typename... Rest>
+    static typename std::enable_if<sizeof...(Rest) == 0 && LuaGlue::is_result<LuaGlue::return_type_t<decltype(F)>>::value, int>::type
+    run(lua_State *L, T *o, int, Prev&... prev)
+    {
+        // result or error, the error is raised by LuaMethod::Call once the arguments are destroyed
+        auto res = call(o, prev...);
+        if (!res)
+            return LuaGlue::push_error(L, res.error());
+        const int count = LuaGlue::push_results(L, res);
+        LUAMETHOD_DEBUG_printf("LuaMethod pushed %d results\n", count);
+        return count;
+    }
+
+    template <typename... Rest>
+    static typename std::enable_if<sizeof...(Rest) == 0 && std::is_same<LuaGlue::return_type_t<decltype(F)>, LuaYield>::value, int>::type
+    run(lua_State *, T *o, int, Prev&... prev)
+    {
+        // yield, done by LuaMethod::Call once the arguments are destroyed
+        const LuaYield res = call(o, prev...);
+        LUAMETHOD_DEBUG_printf("LuaMethod yields %d values\n", res.count);
+        return LuaGlue::yield_results(res.count > 0 ? res.count : 0);
+    }
+
+    template <typename... Rest>
+    static typename std::enable_if<sizeof...(Rest) == 0 && LuaGlue::async_traits<LuaGlue::return_type_t<decltype(F)>>::value, int>::type
+    run(lua_State *L, T *o, int, Prev&... prev)
+    {
+        // e.g. LuaAsync, yield or error is done by LuaMethod::Call once the arguments are destroyed
+        LUAMETHOD_DEBUG_printf("LuaMethod starts async result\n");
+        return LuaGlue::async_traits<LuaGlue::return_type_t<decltype(F)>>::start(L, call(o, prev...));
+    }
+
+    template <typename... Rest>
+    static typename std::enable_if<sizeof...(Rest) == 0 && LuaGlue::is_tuple<LuaGlue::return_type_t<decltype(F)>>::value, int>::type
+    run(lua_State *L, T *o, int, Prev&... prev)
+    {
+        // result is tuple or pair, push each element as separate return value
+        auto res = call(o, prev...);
+        const int count = LuaGlue::push_tuple(L, res, std::make_index_sequence<std::tuple_size<decltype(res)>::value>());
+        LUAMETHOD_DEBUG_printf("LuaMethod pushed %d results\n", count);
+        return count;
+    }
+
     template <typename... Rest>
     static typename std::enable_if<sizeof...(Rest) == 0 && !std::is_same<LuaGlue::return_type_t<decltype(F)>, void>::value
 #ifndef NO_LUAMETHOD_JSON
             && !std::is_same<LuaGlue::return_type_t<decltype(F)>, json>::value
 #endif
+            && !LuaGlue::is_tuple<LuaGlue::return_type_t<decltype(F)>>::value
+            && !LuaGlue::is_result<LuaGlue::return_type_t<decltype(F)>>::value
+            && !std::is_same<LuaGlue::return_type_t<decltype(F)>, LuaYield>::value
+            && !LuaGlue::async_traits<LuaGlue::return_type_t<decltype(F)>>::value
             , int>::type
-    run(lua_State *L, T *o, int n, Prev... prev)
+    run(lua_State *L, T *o, int, Prev&... prev)
     {
         // result is non-void non-json
-        auto res = (o->*F)(prev...);
+        auto res = call(o, prev...);
         Lua(L).Push(res);
         LUAMETHOD_DEBUG_printf("LuaMethod pushed result\n");
         return 1;
@@ -209,39 +468,105 @@ struct LuaMethod {
 
     template <class R = int, std::size_t N = sizeof...(Args)>
     static typename std::enable_if<!hasArgs(), R>::type // alternatively we could specialize run on Args... = <void>
-    Func(lua_State *L) {
-        T* o = T::luaL_checkthis(L, 1);
-        if (!o)
-            return 0;
+    Run(lua_State *L, T *o, int n) {
+        return LuaMethodHelper<T, FT, F>::template run<>(L, o, n); // no args
+    }
+
+    template <class R = int, std::size_t N = sizeof...(Args)>
+    static typename std::enable_if<hasArgs(), R>::type
+    Run(lua_State *L, T *o, int n) {
+        return LuaMethodHelper<T, FT, F>::template run<Args...>(L, o, n); // with args
+    }
+
+    // calls F on o with args starting at stack index n
+    static int Call(lua_State *L, T *o, int n) {
+        int res;
 #ifdef LUAMETHOD_HAS_EXCEPTIONS
         try {
-            return LuaMethodHelper<T, FT, F>::template run<>(L, o, 2); // no args
+            res = Run(L, o, n);
         } catch (const std::exception &e) {
-            luaL_error(L, "%s", e.what());
-            return 0;
+            res = LuaGlue::push_error(L, e.what(), strlen(e.what()));
         }
 #else
-        return LuaMethodHelper<T, FT, F>::template run<>(L, o, 2); // no args
+        res = Run(L, o, n);
 #endif
+        // arguments, results and the exception are destroyed at this point, so the longjmp does not skip them
+        if (res == LuaGlue::RaiseError)
+            return lua_error(L);
+        if (res <= LuaGlue::Yield)
+            return LuaGlue::yield(L, LuaGlue::Yield - res);
+        return res;
     }
 
-    template <class R = int, std::size_t N = sizeof...(Args)>
-    static typename std::enable_if<hasArgs(), R>::type
-    Func(lua_State *L) {
+    static int Func(lua_State *L) {
         T* o = T::luaL_checkthis(L, 1);
         if (!o)
             return 0;
-#ifdef LUAMETHOD_HAS_EXCEPTIONS
-        try {
-            return LuaMethodHelper<T, FT, F>::template run<Args...>(L, o, 2); // with args
-        } catch (const std::exception &e) {
-            luaL_error(L, "%s", e.what());
-            return 0;
-        }
+        return Call(L, o, 2);
+    }
+
+    constexpr static size_t ArgCount = !hasArgs() ? 0 : sizeof...(Args);
+};
+
+// same as LuaMethod for free and static functions, arguments start at stack index 1
+
+template <class FT, FT F, typename... Args>
+struct LuaFunction {
+    static int Func(lua_State *L) {
+        return LuaMethod<void, FT, F, Args...>::Call(L, nullptr, 1);
+    }
+
+    constexpr static size_t ArgCount = LuaMethod<void, FT, F, Args...>::ArgCount;
+};
+
+// getter/setter pair called by LuaInterface's __index and __newindex with (self, key[, value]) on the stack
+// conversion is the same as for LuaMethod return values and arguments
+
+template <class T, class FT, FT F>
+struct LuaPropertyGetter {
+    static int Get(lua_State *L, T *o) {
+        return LuaMethod<T, FT, F>::Call(L, o, 3);
+    }
+};
+
+template <class T, class FT, FT F, typename Arg>
+struct LuaPropertySetter {
+    static void Set(lua_State *L, T *o) {
+        LuaMethod<T, FT, F, Arg>::Call(L, o, 3);
+    }
+};
+
+// argument type used to read a data member of type V from Lua
+template <typename V>
+struct LuaPropertyArg { using type = V; };
+#if __cplusplus >= 201703L
+template <>
+struct LuaPropertyArg<std::string> { using type = std::string_view; };
 #else
-        return LuaMethodHelper<T, FT, F>::template run<Args...>(L, o, 2); // with args
+template <>
+struct LuaPropertyArg<std::string> { using type = const char*; }; // up to the first embedded \0
 #endif
+template <>
+struct LuaPropertyArg<float> { using type = double; };
+
+template <class T, class MT, MT M>
+struct LuaMemberProperty {
+    using Value = std::remove_cv_t<LuaGlue::member_type_t<MT>>;
+    using Arg = typename LuaPropertyArg<Value>::type;
+
+    static Value GetValue(T *o) {
+        return o->*M;
     }
 
-    constexpr static size_t ArgCount = !hasArgs() ? 0 : sizeof...(Args);
+    static void SetValue(T *o, Arg value) {
+        o->*M = static_cast<Value>(value);
+    }
+
+    static int Get(lua_State *L, T *o) {
+        return LuaPropertyGetter<T, Value (*)(T*), &GetValue>::Get(L, o);
+    }
+
+    static void Set(lua_State *L, T *o) {
+        LuaPropertySetter<T, void (*)(T*, Arg), &SetValue, Arg>::Set(L, o);
+    }
 };
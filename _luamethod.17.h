@@ -4,14 +4,25 @@
 #error "Please include luamethod.h instead"
 #endif
 
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 #include "lua_include.h"
 #include "luapp.h" // provides function overloading for push
 #include "luaref.h" // provides reference for lua references (functions, ...)
 #include "luavariant.h"
+#include "luavarargs.h" // remaining arguments as view
 #include "lua_utils.h" // wraps (most) possible lua results
 #ifndef NO_LUAMETHOD_JSON
 #include "lua_json.h"
 #endif
+#include "luaresult.h" // LuaResult return values
+#include "luayield.h" // LuaYield return values
+#include "_return_type.h"
+#include "_luaerror.h" // non-raising argument checks
 
 #if defined __cpp_exceptions || defined __EXCEPTIONS || defined _CPPUNWIND
 #   define LUAMETHOD_HAS_EXCEPTIONS
@@ -29,10 +40,64 @@
 #endif
 
 // helper to generate a map name => func pointer
-// TODO: (argument count to) allow overloads?
+// see _luaoverloads.h for LUA_OVERLOADS
 #define LUA_METHOD(CLASS, METHOD, ...) { STRINGIFY(METHOD), LuaMethod<CLASS,&CLASS::METHOD,__VA_ARGS__>::Func }
 // (Tracker, AddItems, const char*) => {"AddItems", LuaMethod<Tracker, &Tracker::AddItems,const char*>::Func}
 
+// helpers to generate a map name => func pointer for functions without self, see LuaGlue::setfuncs
+// LUA_FUNCTION: free function, (parse, const char*) => {"parse", LuaFunction<&parse,const char*>::Func}
+// LUA_STATIC_METHOD: static member function, (Tracker, Find, int) => {"Find", LuaFunction<&Tracker::Find,int>::Func}
+#define LUA_FUNCTION(FUNC, ...) { STRINGIFY(FUNC), LuaFunction<&FUNC,__VA_ARGS__>::Func }
+#define LUA_STATIC_METHOD(CLASS, METHOD, ...) { STRINGIFY(METHOD), LuaFunction<&CLASS::METHOD,__VA_ARGS__>::Func }
+
+// helpers to generate a map name => getter/setter for LuaInterface::MakePropertyMap
+// LUA_PROPERTY: read/write data member, (Tracker, name) => {"name", {get name, set name}}
+// LUA_PROPERTY_READONLY: read-only data member
+// LUA_PROPERTY_GETSET: getter method without args and setter method with one arg of type TYPE
+// LUA_PROPERTY_GET: read-only property from a getter method
+#define LUA_PROPERTY(CLASS, MEMBER) { STRINGIFY(MEMBER), { LuaMemberProperty<CLASS,&CLASS::MEMBER>::Get, \
+                                                           LuaMemberProperty<CLASS,&CLASS::MEMBER>::Set } }
+#define LUA_PROPERTY_READONLY(CLASS, MEMBER) { STRINGIFY(MEMBER), { LuaMemberProperty<CLASS,&CLASS::MEMBER>::Get, nullptr } }
+#define LUA_PROPERTY_GETSET(CLASS, NAME, GETTER, SETTER, TYPE) { STRINGIFY(NAME), { LuaPropertyGetter<CLASS,&CLASS::GETTER>::Get, \
+                                                                                   LuaPropertySetter<CLASS,&CLASS::SETTER,TYPE>::Set } }
+#define LUA_PROPERTY_GET(CLASS, NAME, GETTER) { STRINGIFY(NAME), { LuaPropertyGetter<CLASS,&CLASS::GETTER>::Get, nullptr } }
+
+namespace LuaGlue {
+
+// pushes a single result value, json is converted to tables
+template <typename V>
+void push_result(lua_State *L, const V& v)
+{
+    Lua(L).Push(v);
+}
+
+#ifndef NO_LUAMETHOD_JSON
+inline void push_result(lua_State *L, const json& v)
+{
+    json_to_lua(L, v);
+}
+#endif
+
+// pushes the value of a successful LuaResult, returns the number of values pushed or RaiseError
+template <typename V>
+int push_results(lua_State *L, const LuaResult<V>& res)
+{
+    if constexpr (std::is_void<V>::value) {
+        return 0;
+    } else if constexpr (is_tuple<V>::value) {
+        constexpr int count = (int)std::tuple_size<V>::value;
+        if (!lua_checkstack(L, count))
+            return push_error(L, "too many results");
+        std::apply([L](const auto&... v) { (push_result(L, v), ...); }, res.value());
+        return count;
+    } else {
+        push_result(L, res.value());
+        return 1;
+    }
+}
+
+} // namespace LuaGlue
+
 // static_assert helper, since we can not directly assert in if constexpr
 template<bool flag = false>
 static void static_unsupported_type() { static_assert(flag, "unsupported type"); }
@@ -42,48 +107,122 @@ static void static_unsupported_type() { static_assert(flag, "unsupported type");
 template <class T, auto F, typename... Prev>
 struct LuaMethodHelper
 {
+    // T is void for functions without object, see LuaFunction
+    // the fetched args are passed down by reference and only moved into F's parameters here,
+    //   they stay lvalues if F takes one of them by non-const reference
+    static decltype(auto) call(T *o, Prev&... prev)
+    {
+        if constexpr (std::is_void<T>::value) {
+            if constexpr (std::is_invocable<decltype(F), Prev&&...>::value)
+                return std::invoke(F, std::forward<Prev>(prev)...);
+            else
+                return std::invoke(F, prev...);
+        } else if constexpr (std::is_invocable<decltype(F), T*, Prev&&...>::value) {
+            return std::invoke(F, o, std::forward<Prev>(prev)...);
+        } else {
+            return std::invoke(F, o, prev...);
+        }
+    }
+
     template <typename Next, typename... Rest>
-    static int get(lua_State *L, T *o, int n, Prev... prev)
+    static int get(lua_State *L, T *o, int n, Prev&... prev)
     {
-        if constexpr (std::is_same<Next, int>::value) {
+        if constexpr (std::is_same<Next, lua_State*>::value) {
+            // calling thread, which is the coroutine if called from one. does not take a Lua argument
+            lua_State *next = L;
+            LUAMETHOD_DEBUG_printf("LuaMethod fetched: lua_State (%zu done, %zu remaining)\n",
+                    sizeof...(Prev), sizeof...(Rest));
+            return LuaMethodHelper<T, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
+        } else if constexpr (std::is_same<Next, Lua&>::value || std::is_same<Next, Lua>::value) {
+            // same for the wrapper, lives until the method returns
+            Lua next(L);
+            LUAMETHOD_DEBUG_printf("LuaMethod fetched: Lua (%zu done, %zu remaining)\n",
+                    sizeof...(Prev), sizeof...(Rest));
+            return LuaMethodHelper<T, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
+        } else if constexpr (std::is_same<Next, int>::value) {
             // NOTE: we just default to 0 for optional args at the moment
-            int next;
-            if (n > lua_gettop(L))
-                next = 0;
-            else
-                next = (int)luaL_checkinteger(L, n);
+            lua_Integer value = 0;
+            if (n <= lua_gettop(L) && !LuaGlue::check_integer(L, n, value))
+                return LuaGlue::RaiseError;
+            int next = (int)value;
             LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d %d (%zu done, %zu remaining)\n",
                     n, next, sizeof...(Prev), sizeof...(Rest));
             n++;
             return LuaMethodHelper<T, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
         } else if constexpr (std::is_same<Next, unsigned>::value) {
-            unsigned next;
-            if (n > lua_gettop(L))
-                next = 0;
-            else if (lua_isinteger(L, n))
+            unsigned next = 0;
+            if (n > lua_gettop(L)) {
+                // default
+            } else if (lua_isinteger(L, n)) {
                 next = (unsigned)lua_tointeger(L, n);
-            else
-                next = (unsigned)luaL_checknumber(L, n);
+            } else {
+                lua_Number value;
+                if (!LuaGlue::check_number(L, n, value))
+                    return LuaGlue::RaiseError;
+                next = (unsigned)value;
+            }
             LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d %u (%zu done, %zu remaining)\n",
                     n, next, sizeof...(Prev), sizeof...(Rest));
             n++;
             return LuaMethodHelper<T, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
         } else if constexpr (std::is_same<Next, int64_t>::value) {
             int64_t next;
-            if (lua_isinteger(L, n))
+            if (lua_isinteger(L, n)) {
                 next = (int64_t)lua_tointeger(L, n);
-            else
-                next = (int64_t)luaL_checknumber(L, n);
+            } else {
+                lua_Number value;
+                if (!LuaGlue::check_number(L, n, value))
+                    return LuaGlue::RaiseError;
+                next = (int64_t)value;
+            }
             LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d %lld (%zu done, %zu remaining)\n",
                     n, (long long)next, sizeof...(Prev), sizeof...(Rest));
             n++;
             return LuaMethodHelper<T, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
+        } else if constexpr (std::is_same<Next, double>::value) {
+            lua_Number value = 0;
+            if (n <= lua_gettop(L) && !LuaGlue::check_number(L, n, value))
+                return LuaGlue::RaiseError;
+            double next = (double)value;
+            LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d %g (%zu done, %zu remaining)\n",
+                    n, next, sizeof...(Prev), sizeof...(Rest));
+            n++;
+            return LuaMethodHelper<T, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
+        } else if constexpr (std::is_same<Next, bool>::value) {
+            // Lua truthiness, missing args are false
+            bool next = lua_toboolean(L, n) != 0;
+            LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d %d (%zu done, %zu remaining)\n",
+                    n, (int)next, sizeof...(Prev), sizeof...(Rest));
+            n++;
+            return LuaMethodHelper<T, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
         } else if constexpr (std::is_same<Next, const char*>::value) {
-            const char* next = luaL_checkstring(L, n);
+            const char* next;
+            size_t len;
+            if (!LuaGlue::check_string(L, n, next, len))
+                return LuaGlue::RaiseError;
             LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d \"%s\" (%zu done, %zu remaining)\n",
                     n, next, sizeof...(Prev), sizeof...(Rest));
             n++;
             return LuaMethodHelper<T, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
+        } else if constexpr (std::is_same<Next, std::string_view>::value) {
+            // points into the Lua string, which is kept alive by the stack during the call
+            const char* s;
+            size_t len;
+            if (!LuaGlue::check_string(L, n, s, len))
+                return LuaGlue::RaiseError;
+            std::string_view next(s, len);
+            LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d \"%.*s\" (%zu done, %zu remaining)\n",
+                    n, (int)next.size(), next.data(), sizeof...(Prev), sizeof...(Rest));
+            n++;
+            return LuaMethodHelper<T, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
+        } else if constexpr (std::is_same<Next, LuaVarArgs>::value) {
+            static_assert(sizeof...(Rest) == 0, "LuaVarArgs has to be the last argument");
+            // everything up to the top of the stack, may be empty
+            LuaVarArgs next = LuaVarArgs::FromStack(L, n);
+            LUAMETHOD_DEBUG_printf("LuaMethod fetched: #%d %zu varargs (%zu done)\n",
+                    n, next.size(), sizeof...(Prev));
+            n += (int)next.size();
+            return LuaMethodHelper<T, F, Prev..., Next>::template run<Rest...>(L, o, n, prev..., next);
         } else if constexpr (std::is_same<Next, LuaRef>::value) {
             lua_pushvalue(L, n); // make copy on top of stack
             LuaRef next;
@@ -114,42 +253,67 @@ struct LuaMethodHelper
     }
 
     template <typename... Rest>
-    static int run(lua_State *L, T *o, int n, Prev... prev)
+    static int run(lua_State *L, T *o, int n, Prev&... prev)
     {
         if constexpr (sizeof...(Rest) > 0) {
             // more args to be retrieved
             return LuaMethodHelper<T,F,Prev...>::template get<Rest...>(L,o,n, prev...);
-        } else if constexpr (std::is_same<decltype((o->*F)(prev...)), void>::value) {
+        } else if constexpr (std::is_same<decltype(call(o, prev...)), void>::value) {
             // result is void
-            (o->*F)(prev...);
+            call(o, prev...);
             LUAMETHOD_DEBUG_printf("LuaMethod return void\n");
             return 0;
-        } else if constexpr (std::is_same<decltype((o->*F)(prev...)), int>::value) {
+        } else if constexpr (std::is_same<decltype(call(o, prev...)), int>::value) {
             // result is int64
-            int res = (o->*F)(prev...);
+            int res = call(o, prev...);
             Lua(L).Push(res);
             LUAMETHOD_DEBUG_printf("LuaMethod pushed int: %d\n", res);
             return 1;
-        } else if constexpr (std::is_same<decltype((o->*F)(prev...)), int64_t>::value) {
+        } else if constexpr (std::is_same<decltype(call(o, prev...)), int64_t>::value) {
             // result is int64
-            int64_t res = (o->*F)(prev...);
+            int64_t res = call(o, prev...);
             Lua(L).Push(res);
             LUAMETHOD_DEBUG_printf("LuaMethod pushed int64: %lld\n", (long long)res);
             return 1;
         // TODO: unsigned result
         // TODO: test if some other return types have conflicts
-        // TODO: maybe allow tuples for more than 1 result value?
+        } else if constexpr (LuaGlue::is_result<decltype(call(o, prev...))>::value) {
+            // result or error, the error is raised by LuaMethod::Call once the arguments are destroyed
+            auto res = call(o, prev...);
+            if (!res)
+                return LuaGlue::push_error(L, res.error());
+            const int count = LuaGlue::push_results(L, res);
+            LUAMETHOD_DEBUG_printf("LuaMethod pushed %d results\n", count);
+            return count;
+        } else if constexpr (std::is_same<decltype(call(o, prev...)), LuaYield>::value) {
+            // yield, done by LuaMethod::Call once the arguments are destroyed
+            const LuaYield res = call(o, prev...);
+            LUAMETHOD_DEBUG_printf("LuaMethod yields %d values\n", res.count);
+            return LuaGlue::yield_results(res.count > 0 ? res.count : 0);
+        } else if constexpr (LuaGlue::async_traits<decltype(call(o, prev...))>::value) {
+            // e.g. LuaAsync, yield or error is done by LuaMethod::Call once the arguments are destroyed
+            LUAMETHOD_DEBUG_printf("LuaMethod starts async result\n");
+            return LuaGlue::async_traits<decltype(call(o, prev...))>::start(L, call(o, prev...));
+        } else if constexpr (LuaGlue::is_tuple<decltype(call(o, prev...))>::value) {
+            // result is tuple or pair, push each element as separate return value
+            auto res = call(o, prev...);
+            constexpr int count = (int)std::tuple_size<decltype(res)>::value;
+            if (!lua_checkstack(L, count)) // raised by LuaMethod::Call once res and the arguments are destroyed
+                return LuaGlue::push_error(L, "too many results");
+            std::apply([L](const auto&... v) { (LuaGlue::push_result(L, v), ...); }, res);
+            LUAMETHOD_DEBUG_printf("LuaMethod pushed %d results\n", count);
+            return count;
 #ifndef NO_LUAMETHOD_JSON
-        } else if constexpr (std::is_same<decltype((o->*F)(prev...)), json>::value) {
+        } else if constexpr (std::is_same<decltype(call(o, prev...)), json>::value) {
             // result is json
-            auto res = (o->*F)(prev...);
+            auto res = call(o, prev...);
             json_to_lua(L, res);
             LUAMETHOD_DEBUG_printf("LuaMethod pushed json: %s\n", res.dump().c_str());
             return 1;
 #endif
         } else {
             // result is other non-void
-            auto res = (o->*F)(prev...);
+            auto res = call(o, prev...);
             Lua(L).Push(res);
             LUAMETHOD_DEBUG_printf("LuaMethod pushed result\n");
             return 1;
@@ -172,27 +336,97 @@ struct LuaMethod {
     constexpr static bool hasArgs() {
         if constexpr (sizeof...(Args) < 1)
             return false;
-        return !argsIsVoid<Args...>();
+        else
+            return !argsIsVoid<Args...>();
     }
 
-    static int Func(lua_State *L) {
-        T* o = T::luaL_checkthis(L, 1);
-        if (!o)
-            return 0;
+    // calls F on o with args starting at stack index n
+    static int Call(lua_State *L, T *o, int n) {
+        int res;
 #ifdef LUAMETHOD_HAS_EXCEPTIONS
         try {
 #endif
             if constexpr (!hasArgs())
-                return LuaMethodHelper<T,F>::template run<>(L, o, 2);
+                res = LuaMethodHelper<T,F>::template run<>(L, o, n);
             else
-                return LuaMethodHelper<T,F>::template run<Args...>(L, o, 2);
+                res = LuaMethodHelper<T,F>::template run<Args...>(L, o, n);
 #ifdef LUAMETHOD_HAS_EXCEPTIONS
         } catch (const std::exception &e) {
-            luaL_error(L, "%s", e.what());
-            return 0;
+            res = LuaGlue::push_error(L, e.what(), strlen(e.what()));
         }
 #endif
+        // arguments, results and the exception are destroyed at this point, so the longjmp does not skip them
+        if (res == LuaGlue::RaiseError)
+            return lua_error(L);
+        if (res <= LuaGlue::Yield)
+            return LuaGlue::yield(L, LuaGlue::Yield - res);
+        return res;
+    }
+
+    static int Func(lua_State *L) {
+        T* o = T::luaL_checkthis(L, 1);
+        if (!o)
+            return 0;
+        return Call(L, o, 2);
     }
 
     constexpr static size_t ArgCount = !hasArgs() ? 0 : sizeof...(Args);
 };
+
+// same as LuaMethod for free and static functions, arguments start at stack index 1
+
+template <auto F, typename... Args>
+struct LuaFunction {
+    static int Func(lua_State *L) {
+        return LuaMethod<void, F, Args...>::Call(L, nullptr, 1);
+    }
+
+    constexpr static size_t ArgCount = LuaMethod<void, F, Args...>::ArgCount;
+};
+
+// getter/setter pair called by LuaInterface's __index and __newindex with (self, key[, value]) on the stack
+// conversion is the same as for LuaMethod return values and arguments
+
+template <class T, auto F>
+struct LuaPropertyGetter {
+    static int Get(lua_State *L, T *o) {
+        return LuaMethod<T, F>::Call(L, o, 3);
+    }
+};
+
+template <class T, auto F, typename Arg>
+struct LuaPropertySetter {
+    static void Set(lua_State *L, T *o) {
+        LuaMethod<T, F, Arg>::Call(L, o, 3);
+    }
+};
+
+// argument type used to read a data member of type V from Lua
+template <typename V>
+struct LuaPropertyArg { using type = V; };
+template <>
+struct LuaPropertyArg<std::string> { using type = std::string_view; };
+template <>
+struct LuaPropertyArg<float> { using type = double; };
+
+template <class T, auto M>
+struct LuaMemberProperty {
+    using Value = std::remove_cv_t<LuaGlue::member_type_t<decltype(M)>>;
+    using Arg = typename LuaPropertyArg<Value>::type;
+
+    static Value GetValue(T *o) {
+        return o->*M;
+    }
+
+    static void SetValue(T *o, Arg value) {
+        o->*M = static_cast<Value>(value);
+    }
+
+    static int Get(lua_State *L, T *o) {
+        return LuaPropertyGetter<T, &GetValue>::Get(L, o);
+    }
+
+    static void Set(lua_State *L, T *o) {
+        LuaPropertySetter<T, &SetValue, Arg>::Set(L, o);
+    }
+};
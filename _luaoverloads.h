@@ -0,0 +1,214 @@
+#pragma once
+
+#ifndef _LUAGLUE_LUAMETHOD_H
+#error "Please include luamethod.h instead"
+#endif
+
+#include <cstdint>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#include <tuple>
+#include <type_traits>
+#include "lua_include.h"
+#include "luapp.h"
+
+// LUA_OVERLOADS: helper to generate a map name => func pointer that dispatches to one of the overloads of METHOD
+// (Tracker, Set, void(const char*), void(const char*, int)) => {"Set", LuaOverloads<Tracker, ...>::Func}
+// Signatures are function types, const methods need the const: int(int) const
+// The first overload with matching argument count and Lua types is called, see LuaOverloadArg
+#define LUA_OVERLOADS(CLASS, METHOD, ...) { STRINGIFY(METHOD), \
+        LuaOverloads<CLASS, _LUA_OVERLOAD_EXPAND(_LUA_OVERLOAD_EACH(CLASS, METHOD, __VA_ARGS__))>::Func }
+
+#define _LUA_OVERLOAD_EXPAND(x) x
+#define _LUA_OVERLOAD_1(C, M, S) LuaOverload<C, S, &C::M>
+#define _LUA_OVERLOAD_2(C, M, S, ...) _LUA_OVERLOAD_1(C, M, S), _LUA_OVERLOAD_EXPAND(_LUA_OVERLOAD_1(C, M, __VA_ARGS__))
+#define _LUA_OVERLOAD_3(C, M, S, ...) _LUA_OVERLOAD_1(C, M, S), _LUA_OVERLOAD_EXPAND(_LUA_OVERLOAD_2(C, M, __VA_ARGS__))
+#define _LUA_OVERLOAD_4(C, M, S, ...) _LUA_OVERLOAD_1(C, M, S), _LUA_OVERLOAD_EXPAND(_LUA_OVERLOAD_3(C, M, __VA_ARGS__))
+#define _LUA_OVERLOAD_5(C, M, S, ...) _LUA_OVERLOAD_1(C, M, S), _LUA_OVERLOAD_EXPAND(_LUA_OVERLOAD_4(C, M, __VA_ARGS__))
+#define _LUA_OVERLOAD_6(C, M, S, ...) _LUA_OVERLOAD_1(C, M, S), _LUA_OVERLOAD_EXPAND(_LUA_OVERLOAD_5(C, M, __VA_ARGS__))
+#define _LUA_OVERLOAD_7(C, M, S, ...) _LUA_OVERLOAD_1(C, M, S), _LUA_OVERLOAD_EXPAND(_LUA_OVERLOAD_6(C, M, __VA_ARGS__))
+#define _LUA_OVERLOAD_8(C, M, S, ...) _LUA_OVERLOAD_1(C, M, S), _LUA_OVERLOAD_EXPAND(_LUA_OVERLOAD_7(C, M, __VA_ARGS__))
+#define _LUA_OVERLOAD_SELECT(_1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+#define _LUA_OVERLOAD_EACH(C, M, ...) _LUA_OVERLOAD_EXPAND(_LUA_OVERLOAD_SELECT(__VA_ARGS__, \
+        _LUA_OVERLOAD_8, _LUA_OVERLOAD_7, _LUA_OVERLOAD_6, _LUA_OVERLOAD_5, \
+        _LUA_OVERLOAD_4, _LUA_OVERLOAD_3, _LUA_OVERLOAD_2, _LUA_OVERLOAD_1)(C, M, __VA_ARGS__))
+
+namespace LuaGlue {
+
+// argument types of a (member) function type, decayed to what LuaMethodHelper fetches
+template <typename T>
+struct function_args;
+
+template <typename R, typename... Args>
+struct function_args<R(Args...)> { using type = std::tuple<std::decay_t<Args>...>; };
+
+template <typename R, typename... Args>
+struct function_args<R(Args...) const> { using type = std::tuple<std::decay_t<Args>...>; };
+
+// number of lua_State* and Lua arguments, which do not take a Lua value
+template <typename... Args>
+constexpr int count_state_args()
+{
+    int count = 0;
+    const bool state[] = {false, (std::is_same<Args, lua_State*>::value || std::is_same<Args, Lua>::value)...};
+    for (bool s: state)
+        count += s ? 1 : 0;
+    return count;
+}
+
+} // namespace LuaGlue
+
+// Lua type an argument of type A has to have to select an overload
+// state is true for arguments that are not taken from the Lua stack
+// integer is true for arguments that need a number with an integer value, see lua_isinteger
+template <typename A>
+struct LuaOverloadArg {
+    // LuaRef, LuaVariant and json take any value
+    static constexpr int type = LUA_TNONE;
+    static constexpr const char* name = "any";
+    static constexpr bool state = false;
+    static constexpr bool integer = false;
+};
+
+template <typename A>
+struct LuaOverloadNumberArg {
+    static constexpr bool state = false;
+    static constexpr int type = LUA_TNUMBER;
+    static constexpr const char* name = std::is_integral<A>::value ? "integer" : "number";
+    static constexpr bool integer = std::is_integral<A>::value;
+};
+
+template <> struct LuaOverloadArg<int> : LuaOverloadNumberArg<int> {};
+template <> struct LuaOverloadArg<unsigned> : LuaOverloadNumberArg<unsigned> {};
+template <> struct LuaOverloadArg<int64_t> : LuaOverloadNumberArg<int64_t> {};
+template <> struct LuaOverloadArg<double> : LuaOverloadNumberArg<double> {};
+
+template <>
+struct LuaOverloadArg<bool> {
+    static constexpr bool state = false;
+    static constexpr int type = LUA_TBOOLEAN;
+    static constexpr const char* name = "boolean";
+    static constexpr bool integer = false;
+};
+
+template <>
+struct LuaOverloadArg<const char*> {
+    static constexpr bool state = false;
+    static constexpr int type = LUA_TSTRING;
+    static constexpr const char* name = "string";
+    static constexpr bool integer = false;
+};
+
+#if __cplusplus >= 201703L
+template <>
+struct LuaOverloadArg<std::string_view> : LuaOverloadArg<const char*> {};
+#endif
+
+// takes the remaining arguments, of any type
+template <>
+struct LuaOverloadArg<LuaVarArgs> {
+    static constexpr bool state = false;
+    static constexpr int type = LUA_TNONE;
+    static constexpr const char* name = "...";
+    static constexpr bool integer = false;
+};
+
+// the calling thread, not part of the signature
+template <>
+struct LuaOverloadArg<lua_State*> {
+    static constexpr bool state = true;
+    static constexpr int type = LUA_TNONE;
+    static constexpr const char* name = "";
+    static constexpr bool integer = false;
+};
+
+template <>
+struct LuaOverloadArg<Lua> : LuaOverloadArg<lua_State*> {};
+
+template <class T, class Sig, Sig T::*F, class Args = typename LuaGlue::function_args<Sig>::type>
+struct LuaOverload;
+
+template <class T, class Sig, Sig T::*F, class... Args>
+struct LuaOverload<T, Sig, F, std::tuple<Args...>> {
+    static constexpr int Count = (int)sizeof...(Args) - LuaGlue::count_state_args<Args...>();
+    static constexpr bool Variadic = std::is_same<
+            typename std::tuple_element<(Count > 0 ? Count - 1 : 0), std::tuple<Args..., void>>::type,
+            LuaVarArgs>::value;
+
+    // arguments start at stack index 2, after self
+    static bool Matches(lua_State *L) {
+        const int top = lua_gettop(L);
+        if (Variadic ? top < Count : top != Count + 1)
+            return false;
+        bool res = true;
+        int n = 2;
+        int dummy[] = {0, (res = res && (LuaOverloadArg<Args>::type == LUA_TNONE ||
+                                         (lua_type(L, n) == LuaOverloadArg<Args>::type &&
+                                          (!LuaOverloadArg<Args>::integer || lua_isinteger(L, n)))),
+                           n += LuaOverloadArg<Args>::state ? 0 : 1)...};
+        (void)dummy;
+        return res;
+    }
+
+    static int Call(lua_State *L, T *o) {
+#ifdef LUA_METHOD_LONG_FORM
+        return LuaMethod<T, Sig T::*, F, Args...>::Call(L, o, 2);
+#else
+        return LuaMethod<T, F, Args...>::Call(L, o, 2);
+#endif
+    }
+
+    // pushes "(type, ...)"
+    static void PushSignature(lua_State *L) {
+        luaL_checkstack(L, 2 * (int)sizeof...(Args) + 2, nullptr);
+        lua_pushliteral(L, "(");
+        int n = 0;
+        int dummy[] = {0, (lua_pushstring(L, LuaOverloadArg<Args>::state ? "" : n++ ? ", " : ""),
+                           lua_pushstring(L, LuaOverloadArg<Args>::name), 0)...};
+        (void)dummy;
+        lua_pushliteral(L, ")");
+        lua_concat(L, 2 * (int)sizeof...(Args) + 2);
+    }
+};
+
+// lua_CFunction that calls the first matching Overload, see LUA_OVERLOADS
+template <class T, class... Overloads>
+struct LuaOverloads {
+    static int Func(lua_State *L) {
+        T* o = T::luaL_checkthis(L, 1);
+        if (!o)
+            return 0;
+        return Dispatch<Overloads...>(L, o);
+    }
+
+private:
+    template <class First, class... Rest>
+    static int Dispatch(lua_State *L, T *o) {
+        if (First::Matches(L))
+            return First::Call(L, o);
+        return Dispatch<Rest...>(L, o);
+    }
+
+    template <class... None>
+    static typename std::enable_if<sizeof...(None) == 0, int>::type
+    Dispatch(lua_State *L, T *) {
+        // build the message on the Lua stack, luaL_error does not return
+        lua_Debug ar;
+        const char* name = nullptr;
+        if (lua_getstack(L, 0, &ar) && lua_getinfo(L, "n", &ar))
+            name = ar.name;
+        if (!name)
+            name = "?";
+        const int top = lua_gettop(L);
+        luaL_checkstack(L, top + 2, nullptr);
+        lua_pushfstring(L, "No matching overload for %s(", name);
+        for (int n = 2; n <= top; n++)
+            lua_pushfstring(L, n > 2 ? ", %s" : "%s", luaL_typename(L, n));
+        lua_pushliteral(L, "), candidates:");
+        lua_concat(L, top + 1);
+        int dummy[] = {0, (lua_pushfstring(L, " %s", name), Overloads::PushSignature(L), lua_concat(L, 3), 0)...};
+        (void)dummy;
+        return luaL_error(L, "%s", lua_tostring(L, -1));
+    }
+};
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <tuple>
+#include <utility>
+
 namespace LuaGlue {
 
 template <typename T>
@@ -50,4 +53,23 @@ struct return_type<R(C::*)(Args...) const volatile&&> { using type = R; };
 template <typename T>
 using return_type_t = typename return_type<T>::type;
 
+template <typename T>
+struct member_type;
+
+template <typename V, typename C>
+struct member_type<V C::*> { using type = V; };
+
+template <typename T>
+using member_type_t = typename member_type<T>::type;
+
+// std::tuple and std::pair, used for multiple return values
+template <typename T>
+struct is_tuple : std::false_type {};
+
+template <typename... Ts>
+struct is_tuple<std::tuple<Ts...>> : std::true_type {};
+
+template <typename A, typename B>
+struct is_tuple<std::pair<A, B>> : std::true_type {};
+
 } // namespace LuaGlue
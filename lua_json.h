@@ -4,6 +4,18 @@
 #include "lua_include.h"
 #include "luacompat.h"
 #include <nlohmann/json.hpp>
+#include <cmath>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#include <unordered_map>
+#include <vector>
 
 
 #if defined __cpp_exceptions || defined __EXCEPTIONS || defined _CPPUNWIND
@@ -12,10 +24,24 @@
         throw std::runtime_error("Max depth reached");
 #   define LUA_TO_JSON_STACK_OVERFLOW() \
         throw std::runtime_error("Stack overflow");
+#   define LUA_TO_JSON_CYCLE_DETECTED() \
+        throw std::runtime_error("Cycle detected");
 #   define JSON_TO_LUA_MAX_DEPTH_REACHED() \
         throw std::runtime_error("Max depth reached");
 #   define JSON_TO_LUA_STACK_OVERFLOW() \
         throw std::runtime_error("Stack overflow");
+#   define LUA_TO_JSON_WRITE_MAX_DEPTH_REACHED() \
+        throw std::runtime_error("Max depth reached");
+#   define LUA_TO_JSON_WRITE_STACK_OVERFLOW() \
+        throw std::runtime_error("Stack overflow");
+#   define LUA_TO_JSON_WRITE_CYCLE_DETECTED() \
+        throw std::runtime_error("Cycle detected");
+#   define JSON_TEXT_TO_LUA_MAX_DEPTH_REACHED() \
+        throw std::runtime_error("Max depth reached");
+#   define JSON_TEXT_TO_LUA_STACK_OVERFLOW() \
+        throw std::runtime_error("Stack overflow");
+#   define JSON_TEXT_TO_LUA_VALUE_STACK_OVERFLOW() \
+        throw std::runtime_error("Stack overflow");
 #else
 #   define LUA_TO_JSON_MAX_DEPTH_REACHED() { \
         fprintf(stderr, "Warning: Max depth reached in lua_to_json. Returning null.\n"); \
@@ -25,6 +51,10 @@
         fprintf(stderr, "Warning: Lua stack overflow in lua_to_json. Returning null.\n"); \
         return nullptr; \
     }
+#   define LUA_TO_JSON_CYCLE_DETECTED() { \
+        fprintf(stderr, "Warning: Cycle detected in lua_to_json. Returning null.\n"); \
+        return nullptr; \
+    }
 #   define JSON_TO_LUA_MAX_DEPTH_REACHED() { \
         lua_pushnil(L); \
         fprintf(stderr, "Warning: Max depth reached in json_to_lua. Returning nil.\n"); \
@@ -35,6 +65,33 @@
         fprintf(stderr, "Warning: Lua stack overflow in json_to_lua. Returning nil.\n"); \
         return; \
     }
+#   define LUA_TO_JSON_WRITE_MAX_DEPTH_REACHED() { \
+        fprintf(stderr, "Warning: Max depth reached in lua_to_json_write. Writing null.\n"); \
+        _write("null", 4); \
+        return; \
+    }
+#   define LUA_TO_JSON_WRITE_STACK_OVERFLOW() { \
+        fprintf(stderr, "Warning: Lua stack overflow in lua_to_json_write. Writing null.\n"); \
+        _write("null", 4); \
+        return; \
+    }
+#   define LUA_TO_JSON_WRITE_CYCLE_DETECTED() { \
+        fprintf(stderr, "Warning: Cycle detected in lua_to_json_write. Writing null.\n"); \
+        _write("null", 4); \
+        return; \
+    }
+#   define JSON_TEXT_TO_LUA_MAX_DEPTH_REACHED() { \
+        fprintf(stderr, "Warning: Max depth reached in json_text_to_lua. Returning nil.\n"); \
+        return skip(); \
+    }
+#   define JSON_TEXT_TO_LUA_STACK_OVERFLOW() { \
+        fprintf(stderr, "Warning: Lua stack overflow in json_text_to_lua. Returning nil.\n"); \
+        return skip(); \
+    }
+#   define JSON_TEXT_TO_LUA_VALUE_STACK_OVERFLOW() { \
+        fprintf(stderr, "Warning: Lua stack overflow in json_text_to_lua. Returning nil.\n"); \
+        return false; \
+    }
 #endif
 
 
@@ -75,201 +132,1058 @@ public:
 #endif
 };
 
-static json lua_to_json(lua_State* L, const int n = -1, const int maxDepth = 1000)
+// true if the keys of the table at idx are exactly 1..len
+static bool lua_to_json_is_sequence(lua_State* L, const int idx, const size_t len)
 {
-    json j;
-    switch (lua_type(L, n)) {
-        case LUA_TNUMBER:
-            if (lua_isinteger(L, n))
-                return lua_tointeger(L, n);
-            return lua_tonumber(L, n);
-        case LUA_TSTRING:
-            return lua_tostring(L, n);
-        case LUA_TBOOLEAN:
-            return static_cast<bool>(lua_toboolean(L, n));
-        case LUA_TTABLE:
-        {
-            if (maxDepth == 1)
-                LUA_TO_JSON_MAX_DEPTH_REACHED();
-            if (!lua_checkstack(L, 2))
-                LUA_TO_JSON_STACK_OVERFLOW();
+    size_t count = 0;
+    lua_pushnil(L); // first key
+    while (lua_next(L, idx)) {
+        lua_pop(L, 1); // value
+        if (lua_type(L, -1) != LUA_TNUMBER || !lua_isinteger(L, -1)) {
+            lua_pop(L, 1);
+            return false;
+        }
+        const lua_Integer key = lua_tointeger(L, -1);
+        if (key < 1 || static_cast<size_t>(key) > len) {
+            lua_pop(L, 1);
+            return false;
+        }
+        count++;
+    }
+    return count == len;
+}
+
+// true if the table at idx has a key that makes lua_to_json convert it to an object, a string or a non-integer number
+static bool lua_to_json_has_object_key(lua_State* L, const int idx)
+{
+    lua_pushnil(L); // first key
+    while (lua_next(L, idx)) {
+        lua_pop(L, 1); // value
+        if (!lua_isinteger(L, -1) && lua_isstring(L, -1)) {
+            lua_pop(L, 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// how lua_to_json handles a table that is reached more than once
+enum class LuaJsonCycles {
+    Fail, // error (null without exceptions) if a table contains itself
+    Null, // null if a table contains itself
+    Reference, // {"$ref": [keys from the root]} for every table that was converted before, including cycles
+               // the keys are JSON keys, like a JSON pointer: 0-based indices for array elements, strings for
+               // object members
+};
+
+// key of the object member whose Lua key is at idx, as used in LuaJsonCycles::Reference markers
+// needs one free stack slot for number keys
+static json lua_to_json_key(lua_State* L, const int idx)
+{
+    if (lua_isinteger(L, idx))
+        return std::to_string(lua_tointeger(L, idx));
+    // number key, convert a copy so lua_next still gets a number
+    lua_pushvalue(L, idx);
+    size_t len;
+    const char* s = lua_tolstring(L, -1, &len);
+    json key = std::string(s, len);
+    lua_pop(L, 1);
+    return key;
+}
+
+// tables that are being converted (or were converted for LuaJsonCycles::Reference), keyed by lua_topointer
+class LuaJsonVisited {
+public:
+    static constexpr size_t None = SIZE_MAX;
+
+    explicit LuaJsonVisited(const LuaJsonCycles mode)
+        : _mode(mode)
+    {
+    }
+
+    LuaJsonCycles mode() const
+    {
+        return _mode;
+    }
+
+    // returns None if p was reached before, otherwise an id to be passed as parent of its values
+    // key() returns the key of p in parent and is only called for LuaJsonCycles::Reference
+    // enter and leave have to be called in LIFO order
+    template <class Key>
+    size_t enter(const void* p, const size_t parent, Key&& key)
+    {
+        if (_mode != LuaJsonCycles::Reference) {
+            if (onPath(p))
+                return None;
+            if (_path.size() >= PathScan)
+                _ids.emplace(p, 0);
+            _path.push_back(p);
+            return 0;
+        }
+        if (!_ids.emplace(p, _entries.size()).second)
+            return None;
+        _entries.push_back({parent, key()});
+        return _entries.size() - 1;
+    }
+
+    void leave(const void* p)
+    {
+        if (_mode == LuaJsonCycles::Reference)
+            return;
+        if (_path.size() > PathScan)
+            _ids.erase(p);
+        _path.pop_back();
+    }
+
+    // marker for a table that was reached before with LuaJsonCycles::Reference
+    json reference(const void* p) const
+    {
+        json path = json::array();
+        for (size_t id = _ids.at(p); _entries[id].parent != None; id = _entries[id].parent)
+            path.push_back(_entries[id].key);
+        std::reverse(path.begin(), path.end());
+        json marker = json::object();
+        marker["$ref"] = std::move(path);
+        return marker;
+    }
+
+private:
+    struct Entry {
+        size_t parent;
+        json key;
+    };
+
+    // the first tables of the path are searched linearly, which is faster than hashing for typical depths
+    static constexpr size_t PathScan = 16;
+
+    LuaJsonCycles _mode;
+    std::vector<const void*> _path; // tables being converted for Fail and Null
+    std::unordered_map<const void*, size_t> _ids; // _path beyond PathScan, or all tables for Reference
+    std::vector<Entry> _entries;
+
+    bool onPath(const void* p) const
+    {
+        const size_t scan = _path.size() < PathScan ? _path.size() : PathScan;
+        for (size_t i = 0; i < scan; i++) {
+            if (_path[i] == p)
+                return true;
+        }
+        return _path.size() > PathScan && _ids.count(p);
+    }
+};
+
+// iterative implementation of lua_to_json, tables that are being converted are kept in a heap allocated stack
+class LuaToJsonConverter {
+public:
+    LuaToJsonConverter(lua_State* L, const LuaJsonCycles cycles)
+        : L(L), _visited(cycles)
+    {
+    }
+
+    json convert(const int n, const int maxDepth)
+    {
+        json j;
+        value(lua_absindex(L, n), maxDepth, j, false, []() { return json(); });
+        while (!_frames.empty()) {
+            if (_frames.back().sequence)
+                stepSequence();
+            else
+                stepTable();
+        }
+        return j;
+    }
+
+private:
+    struct Frame {
+        json* target; // points into the parent's json, which is not modified while this frame is active
+        int idx; // absolute index of the table
+        int depth; // maxDepth of the table
+        const void* ptr; // lua_topointer of the table
+        size_t id; // LuaJsonVisited id of the table
+        bool popOnExit; // table was pushed by the parent frame
+        bool sequence; // keys are exactly 1..len, see lua_to_json_is_sequence
+        size_t len;
+        size_t next;
+    };
+
+    lua_State* L;
+    std::vector<Frame> _frames;
+    LuaJsonVisited _visited;
+
+    // converts a non-table value to target, or starts converting a table
+    // returns true if a frame was started, which will pop the table (if popOnExit) when done
+    template <class Key>
+    bool value(const int n, const int maxDepth, json& target, const bool popOnExit, Key&& key)
+    {
+        switch (lua_type(L, n)) {
+            case LUA_TNUMBER:
+                if (lua_isinteger(L, n))
+                    target = static_cast<json::number_integer_t>(lua_tointeger(L, n));
+                else
+                    target = static_cast<json::number_float_t>(lua_tonumber(L, n));
+                return false;
+            case LUA_TSTRING:
+            {
+                size_t len;
+                const char* s = lua_tolstring(L, n, &len);
+                target = json::string_t(s, len);
+                return false;
+            }
+            case LUA_TBOOLEAN:
+                target = static_cast<bool>(lua_toboolean(L, n));
+                return false;
+            case LUA_TTABLE:
+                return table(n, maxDepth, target, popOnExit, key) != nullptr;
+            case LUA_TUSERDATA:
+            case LUA_TLIGHTUSERDATA:
+                if (LuaJson_EmptyArray::Lua_is(L, n)) {
+                    target = json::array(); // empty array
+                    return false;
+                }
+                // fall through
+            case LUA_TNIL:
+            case LUA_TNONE:
+            default:
+                return false; // leave NULL
+        }
+    }
+
+    // pushes a frame for the table at n, returns nullptr if it can't be converted
+    template <class Key>
+    const Frame* table(const int n, const int maxDepth, json& target, const bool popOnExit, Key&& key)
+    {
+        if (maxDepth == 1)
+            LUA_TO_JSON_MAX_DEPTH_REACHED();
+        if (!lua_checkstack(L, 2))
+            LUA_TO_JSON_STACK_OVERFLOW();
+        const void* ptr = lua_topointer(L, n);
+        const size_t id = _visited.enter(ptr, _frames.empty() ? LuaJsonVisited::None : _frames.back().id, key);
+        if (id == LuaJsonVisited::None) {
+            if (_visited.mode() == LuaJsonCycles::Reference)
+                target = _visited.reference(ptr);
+            else if (_visited.mode() == LuaJsonCycles::Fail)
+                LUA_TO_JSON_CYCLE_DETECTED();
+            return nullptr; // leave NULL
+        }
+        const size_t len = lua_rawlen(L, n);
+        const bool sequence = len > 0 && lua_to_json_is_sequence(L, n, len);
+        if (sequence) {
+            // fast path for sequences: convert in order into a reserved array
+            target = json::array();
+            target.get_ref<json::array_t&>().reserve(len);
+        } else {
+            // keys are recorded when the elements are reached, so the table can't turn into an object afterwards
+            if (_visited.mode() == LuaJsonCycles::Reference && lua_to_json_has_object_key(L, n))
+                target = json::object();
             lua_pushnil(L); // first key
-            while (lua_next(L, (n < 0) ? (n - 1) : n)) {
-                // key now at -2, value at -1
-                if (lua_isinteger(L, -2)) {
-                    if (j.is_null())
-                        j = json::array();
-                    if (j.is_object()) {
-                        // NOTE: key will be a string when converting mixed back; this has to be handled in lua
-                        const lua_Integer ikey = lua_tointeger(L, -2);
-                        const std::string key = std::to_string(ikey);
-#ifdef LUA_JSON_HAS_EXCEPTIONS
-                        try {
-                            j[key] = lua_to_json(L);
-                        } catch (...) {
-                            lua_pop(L, 2);
-                            throw;
-                        }
-#else
-                        j[key] = lua_to_json(L);
-#endif
-                    } else {
-                        const lua_Integer key = lua_tointeger(L, -2);
-                        if (key > 0) { // nlohmann::json arrays are zero-based, Lua arrays are one-based
+        }
+        _frames.push_back({&target, n, maxDepth, ptr, id, popOnExit, sequence, len, 1});
+        return &_frames.back();
+    }
+
+    void finish()
+    {
+        const bool pop = _frames.back().popOnExit;
+        _visited.leave(_frames.back().ptr);
+        _frames.pop_back();
+        if (pop)
+            lua_pop(L, 1); // table, this exposes the key of the parent frame for lua_next
+    }
+
+    void stepSequence()
+    {
+        Frame& frame = _frames.back();
+        if (frame.next > frame.len) {
+            finish();
+            return;
+        }
+        auto& arr = frame.target->get_ref<json::array_t&>();
+        const int depth = frame.depth;
+        const size_t i = frame.next++;
+        lua_rawgeti(L, frame.idx, static_cast<int>(i)); // rawgeti takes an int before Lua 5.3
+        arr.emplace_back();
+        // frame is invalid after this if a new frame was pushed
+        if (!value(lua_gettop(L), depth - 1, arr.back(), true, [i]() { return json(static_cast<json::number_integer_t>(i - 1)); }))
+            lua_pop(L, 1);
+    }
+
+    void stepTable()
+    {
+        Frame& frame = _frames.back();
+        json& j = *frame.target;
+        const int depth = frame.depth;
+        if (!lua_next(L, frame.idx)) {
+            if (j.is_null())
+                j = json::object(); // return empty object for empty table
+            finish();
+            return;
+        }
+        // key now at -2, value at -1
+        json* target = nullptr;
+        lua_Integer index = -1; // of the array element
+        if (lua_isinteger(L, -2)) {
+            if (j.is_null())
+                j = json::array();
+            if (j.is_object()) {
+                // NOTE: key will be a string when converting mixed back; this has to be handled in lua
+                const lua_Integer ikey = lua_tointeger(L, -2);
+                target = &j[std::to_string(ikey)];
+            } else {
+                const lua_Integer key = lua_tointeger(L, -2);
+                if (key > 0) { // nlohmann::json arrays are zero-based, Lua arrays are one-based
+                    index = key - 1;
+                    target = &j[static_cast<size_t>(index)];
+                } else
+                    fprintf(stderr, "Warning: Invalid array index: %ld\n", static_cast<long>(key));
+            }
+        } else if (lua_isstring(L, -2)) {
+            if (j.is_null())
+                j = json::object();
+            if (j.is_array()) {
+                // convert array to object for mixed table
+                json arr = std::move(j);
+                j = json::object();
+                lua_Integer i = 1;
+                for (auto& it: arr) {
+                    const std::string key = std::to_string(i);
+                    j[key] = std::move(it);
+                    i++;
+                }
+            }
+            size_t len;
+            if (lua_type(L, -2) == LUA_TSTRING) {
+                const char* key = lua_tolstring(L, -2, &len);
+                target = &j[json::string_t(key, len)];
+            } else {
+                // number key, convert a copy so lua_next still gets a number
+                lua_pushvalue(L, -2);
+                const char* key = lua_tolstring(L, -1, &len);
+                json::string_t skey(key, len);
+                lua_pop(L, 1);
+                target = &j[skey];
+            }
+        } else {
+            fprintf(stderr, "Warning: unhandled table key type %d\n", lua_type(L, -2));
+        }
+        // frame is invalid after this if a new frame was pushed
+        const int top = lua_gettop(L);
+        if (!target || !value(top, depth - 1, *target, true, [this, top, index]() {
+                return index >= 0 ? json(static_cast<json::number_integer_t>(index)) : lua_to_json_key(L, top - 1);
+            }))
+            lua_pop(L, 1); // pop value, keep key (used in lua_next())
+    }
+};
+
+static json lua_to_json(lua_State* L, const int n = -1, const int maxDepth = 1000,
+                        const LuaJsonCycles cycles = LuaJsonCycles::Fail)
+{
+    LuaToJsonConverter converter(L, cycles);
 #ifdef LUA_JSON_HAS_EXCEPTIONS
-                            try {
-                                j[key - 1] = lua_to_json(L, -1, maxDepth - 1);
-                            } catch (...) {
-                                lua_pop(L, 2);
-                                throw;
-                            }
+    const int top = lua_gettop(L);
+    try {
+        return converter.convert(n, maxDepth);
+    } catch (...) {
+        lua_settop(L, top);
+        throw;
+    }
 #else
-                            j[key - 1] = lua_to_json(L, -1, maxDepth - 1);
+    return converter.convert(n, maxDepth);
 #endif
-                        } else {
-                            fprintf(stderr, "Warning: Invalid array index: %ld\n", static_cast<long>(key));
-                        }
-                    }
-                } else if (lua_isstring(L, -2)) {
-                    if (j.is_null())
-                        j = json::object();
-                    if (j.is_array()) {
-                        // convert array to object for mixed table
-                        json arr = j;
-                        j = json::object();
-                        lua_Integer i = 1;
-                        for (const auto& it: arr) {
-                            const std::string key = std::to_string(i);
-                            j[key] = it;
-                            i++;
-                        }
-                    }
-                    const char* key = lua_tostring(L, -2);
-#ifdef LUA_JSON_HAS_EXCEPTIONS
-                    try {
-                        j[key] = lua_to_json(L, -1, maxDepth - 1);
-                    } catch (...) {
-                        lua_pop(L, 2);
-                        throw;
-                    }
+}
+
+// writes the finite number d as json::dump() does (shortest round-trip representation) and returns the length
+// nlohmann::detail::to_chars is not public API, so it is only used for the versions it is known to exist in,
+// otherwise or with LUA_JSON_NO_DETAIL_TO_CHARS defined, the number is formatted through dump()
+static size_t lua_json_format_double(char* buf, const size_t size, const double d)
+{
+#if NLOHMANN_JSON_VERSION_MAJOR == 3 && NLOHMANN_JSON_VERSION_MINOR >= 1 && !defined LUA_JSON_NO_DETAIL_TO_CHARS
+    return static_cast<size_t>(nlohmann::detail::to_chars(buf, buf + size, d) - buf);
 #else
-                    j[key] = lua_to_json(L, -1, maxDepth - 1);
+    const std::string s = json(d).dump();
+    const size_t len = std::min(s.size(), size);
+    memcpy(buf, s.data(), len);
+    return len;
 #endif
-                } else {
-                    fprintf(stderr, "Warning: unhandled table key type %d\n", lua_type(L, -2));
+}
+
+// streaming variant of lua_to_json that writes JSON text instead of building a json DOM
+// Writer is called as write(const char* data, size_t len)
+template <class Writer>
+class LuaJsonWriter {
+public:
+    LuaJsonWriter(lua_State* L, Writer& write, const LuaJsonCycles cycles = LuaJsonCycles::Fail)
+        : L(L), _write(write), _visited(cycles)
+    {
+    }
+
+    void value(const int n, const int maxDepth)
+    {
+        value(n, maxDepth, []() { return json(); });
+    }
+
+private:
+    lua_State* L;
+    Writer& _write;
+    LuaJsonVisited _visited;
+    size_t _parent = LuaJsonVisited::None; // LuaJsonVisited id of the table being written
+
+    template <class Key>
+    void value(const int n, const int maxDepth, Key&& key)
+    {
+        switch (lua_type(L, n)) {
+            case LUA_TNUMBER:
+                if (lua_isinteger(L, n))
+                    integer(lua_tointeger(L, n));
+                else
+                    number(lua_tonumber(L, n));
+                break;
+            case LUA_TSTRING:
+            {
+                size_t len;
+                const char* s = lua_tolstring(L, n, &len);
+                string(s, len);
+                break;
+            }
+            case LUA_TBOOLEAN:
+                if (lua_toboolean(L, n))
+                    _write("true", 4);
+                else
+                    _write("false", 5);
+                break;
+            case LUA_TTABLE:
+                table(n, maxDepth, key);
+                break;
+            case LUA_TUSERDATA:
+            case LUA_TLIGHTUSERDATA:
+                if (LuaJson_EmptyArray::Lua_is(L, n)) {
+                    _write("[]", 2);
+                    break;
+                }
+                // fall through
+            case LUA_TNIL:
+            case LUA_TNONE:
+            default:
+                _write("null", 4);
+                break;
+        }
+    }
+
+    void integer(const lua_Integer i)
+    {
+        char buf[24];
+        char* end = buf + sizeof(buf);
+        char* p = end;
+        // negate as unsigned to handle the minimum value
+        uint64_t u = i < 0 ? 0 - static_cast<uint64_t>(i) : static_cast<uint64_t>(i);
+        do {
+            *--p = static_cast<char>('0' + u % 10);
+            u /= 10;
+        } while (u);
+        if (i < 0)
+            *--p = '-';
+        _write(p, static_cast<size_t>(end - p));
+    }
+
+    void number(const lua_Number n)
+    {
+        const double d = static_cast<double>(n); // lua_to_json stores all floats as double
+        if (!std::isfinite(d)) {
+            _write("null", 4); // same as json::dump()
+            return;
+        }
+        char buf[64];
+        const size_t len = lua_json_format_double(buf, sizeof(buf), d);
+        _write(buf, len);
+    }
+
+    void string(const char* s, const size_t len)
+    {
+        // escapes like json::dump(); bytes >= 0x80 are copied as is
+        static constexpr char hex[] = "0123456789abcdef";
+        _write("\"", 1);
+        size_t start = 0;
+        for (size_t i = 0; i < len; i++) {
+            const auto c = static_cast<unsigned char>(s[i]);
+            if (c >= 0x20 && c != '"' && c != '\\')
+                continue;
+            if (i > start)
+                _write(s + start, i - start);
+            start = i + 1;
+            switch (c) {
+                case '"': _write("\\\"", 2); break;
+                case '\\': _write("\\\\", 2); break;
+                case '\b': _write("\\b", 2); break;
+                case '\f': _write("\\f", 2); break;
+                case '\n': _write("\\n", 2); break;
+                case '\r': _write("\\r", 2); break;
+                case '\t': _write("\\t", 2); break;
+                default:
+                {
+                    const char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+                    _write(esc, sizeof(esc));
+                    break;
                 }
-                // pop value, keep key (used in lua_next())
-                lua_pop(L, 1);
             }
-            if (j.is_null())
-                j = json::object(); // return empty object for empty table
-            break;
         }
-        case LUA_TUSERDATA:
-        case LUA_TLIGHTUSERDATA:
-            if (LuaJson_EmptyArray::Lua_is(L, n)) {
-                j = json::array(); // empty array
+        if (len > start)
+            _write(s + start, len - start);
+        _write("\"", 1);
+    }
+
+    template <class Key>
+    void table(const int n, const int maxDepth, Key&& key)
+    {
+        if (maxDepth == 1)
+            LUA_TO_JSON_WRITE_MAX_DEPTH_REACHED();
+        if (!lua_checkstack(L, 3))
+            LUA_TO_JSON_WRITE_STACK_OVERFLOW();
+        const void* ptr = lua_topointer(L, n);
+        const size_t id = _visited.enter(ptr, _parent, key);
+        if (id == LuaJsonVisited::None) {
+            if (_visited.mode() == LuaJsonCycles::Fail)
+                LUA_TO_JSON_WRITE_CYCLE_DETECTED();
+            if (_visited.mode() == LuaJsonCycles::Reference) {
+                const std::string marker = _visited.reference(ptr).dump();
+                _write(marker.data(), marker.size());
+            } else {
+                _write("null", 4);
+            }
+            return;
+        }
+        const size_t parent = _parent;
+        _parent = id;
+        entries(n, maxDepth);
+        _parent = parent;
+        _visited.leave(ptr);
+    }
+
+    void entries(const int n, const int maxDepth)
+    {
+        // first pass: array if there are only integer keys, object if there is any string key, like lua_to_json
+        bool isArray = false;
+        bool isObject = false;
+        lua_Integer size = 0;
+        lua_Integer invalidIndex = 1;
+        int unhandledKeyType = LUA_TNONE;
+        lua_pushnil(L);
+        while (lua_next(L, n)) {
+            lua_pop(L, 1);
+            if (lua_isinteger(L, -1)) {
+                const lua_Integer key = lua_tointeger(L, -1);
+                isArray = true;
+                if (key > size)
+                    size = key;
+                else if (key < 1)
+                    invalidIndex = key;
+            } else if (lua_isstring(L, -1)) {
+                isObject = true;
+                lua_pop(L, 1);
                 break;
+            } else {
+                unhandledKeyType = lua_type(L, -1);
             }
-            // fall through
-        case LUA_TNIL:
-        case LUA_TNONE:
-        default:
-            break; // return NULL
+        }
+        if (isObject) {
+            object(n, maxDepth);
+            return;
+        }
+        if (unhandledKeyType != LUA_TNONE)
+            fprintf(stderr, "Warning: unhandled table key type %d\n", unhandledKeyType);
+        if (!isArray) {
+            _write("{}", 2); // empty object for empty table
+            return;
+        }
+        if (invalidIndex < 1)
+            fprintf(stderr, "Warning: Invalid array index: %ld\n", static_cast<long>(invalidIndex));
+        // missing elements are null, same as with nlohmann::json arrays
+        _write("[", 1);
+        for (lua_Integer i = 1; i <= size; i++) {
+            if (i > 1)
+                _write(",", 1);
+            lua_pushinteger(L, i);
+            lua_rawget(L, n);
+            value(lua_gettop(L), maxDepth - 1, [i]() { return json(static_cast<json::number_integer_t>(i - 1)); });
+            lua_pop(L, 1);
+        }
+        _write("]", 1);
+    }
+
+    void object(const int n, const int maxDepth)
+    {
+        // NOTE: integer keys are converted to strings, this has to be handled in lua when converting back
+        bool first = true;
+        _write("{", 1);
+        lua_pushnil(L);
+        while (lua_next(L, n)) {
+            // key now at -2, value at -1
+            if (lua_isinteger(L, -2)) {
+                if (!first)
+                    _write(",", 1);
+                _write("\"", 1);
+                integer(lua_tointeger(L, -2));
+                _write("\":", 2);
+            } else if (lua_type(L, -2) == LUA_TSTRING) {
+                if (!first)
+                    _write(",", 1);
+                size_t len;
+                const char* key = lua_tolstring(L, -2, &len);
+                string(key, len);
+                _write(":", 1);
+            } else if (lua_isstring(L, -2)) {
+                // number key, convert a copy so lua_next still gets a number
+                if (!first)
+                    _write(",", 1);
+                lua_pushvalue(L, -2);
+                size_t len;
+                const char* key = lua_tolstring(L, -1, &len);
+                string(key, len);
+                lua_pop(L, 1);
+                _write(":", 1);
+            } else {
+                fprintf(stderr, "Warning: unhandled table key type %d\n", lua_type(L, -2));
+                lua_pop(L, 1);
+                continue;
+            }
+            first = false;
+            const int top = lua_gettop(L);
+            value(top, maxDepth - 1, [this, top]() { return lua_to_json_key(L, top - 1); });
+            // pop value, keep key (used in lua_next())
+            lua_pop(L, 1);
+        }
+        _write("}", 1);
+    }
+};
+
+// writes the Lua value at n as JSON text, see LuaJsonWriter
+template <class Writer>
+static void lua_to_json_write(lua_State* L, const int n, Writer&& write, const int maxDepth = 1000,
+                              const LuaJsonCycles cycles = LuaJsonCycles::Fail)
+{
+    LuaJsonWriter<typename std::remove_reference<Writer>::type> writer(L, write, cycles);
+#ifdef LUA_JSON_HAS_EXCEPTIONS
+    const int top = lua_gettop(L);
+    try {
+        writer.value(lua_absindex(L, n), maxDepth);
+    } catch (...) {
+        lua_settop(L, top);
+        throw;
     }
-    return j;
+#else
+    writer.value(lua_absindex(L, n), maxDepth);
+#endif
 }
 
-static void json_to_lua(lua_State* L, const json& j, const int maxDepth = 1000)
+// appends the Lua value at n as JSON text to out, like out += lua_to_json(L, n).dump(), except that
+// - object keys are written in table order instead of sorted
+// - strings are written as they are, dump() throws json::type_error 316 for invalid UTF-8
+// - integer keys of tables with string keys are always written as they are, lua_to_json numbers the integer keys it
+//   sees before the first string key by position instead, with null for gaps
+static void lua_to_json_string(lua_State* L, const int n, std::string& out, const int maxDepth = 1000,
+                               const LuaJsonCycles cycles = LuaJsonCycles::Fail)
 {
-    if (!lua_checkstack(L, 1))
-        JSON_TO_LUA_STACK_OVERFLOW();
-    switch (j.type()) {
-        case json::value_t::number_unsigned:
-            if ((sizeof(lua_Integer) >= 8 && j.get<uint64_t>() <= INT64_MAX) || j.get<uint64_t>() <= INT32_MAX) {
-                lua_pushinteger(L, j);
-            } else {
-                lua_pushnumber(L, j);
+#ifdef LUA_JSON_HAS_EXCEPTIONS
+    const size_t size = out.size();
+    try {
+        lua_to_json_write(L, n, [&out](const char* data, size_t len) { out.append(data, len); }, maxDepth, cycles);
+    } catch (...) {
+        out.resize(size);
+        throw;
+    }
+#else
+    lua_to_json_write(L, n, [&out](const char* data, size_t len) { out.append(data, len); }, maxDepth, cycles);
+#endif
+}
+
+static std::string lua_to_json_string(lua_State* L, const int n = -1, const int maxDepth = 1000,
+                                      const LuaJsonCycles cycles = LuaJsonCycles::Fail)
+{
+    std::string out;
+    lua_to_json_string(L, n, out, maxDepth, cycles);
+    return out;
+}
+
+// iterative implementation of json_to_lua, containers that are being converted are kept in a heap allocated stack
+class JsonToLuaConverter {
+public:
+    explicit JsonToLuaConverter(lua_State* L)
+        : L(L)
+    {
+    }
+
+    void convert(const json& j, const int maxDepth)
+    {
+        if (!lua_checkstack(L, 1))
+            JSON_TO_LUA_STACK_OVERFLOW();
+        value(j, maxDepth);
+        while (!_frames.empty()) {
+            Frame& frame = _frames.back();
+            if (frame.it == frame.end) {
+                // table is done, store it in the parent
+                _frames.pop_back();
+                store();
+                continue;
             }
-            break;
-        case json::value_t::number_integer:
-            if (sizeof(lua_Integer) >= 8 || (j.get<int64_t>() <= INT32_MAX && j.get<int64_t>() >= INT32_MIN)) {
-                lua_pushinteger(L, j);
-            } else {
+            const auto it = frame.it++;
+            if (frame.isObject) {
+                const std::string& key = it.key();
+                lua_pushlstring(L, key.data(), key.size());
+            }
+            // frame is invalid after this if a new frame was pushed
+            if (!value(*it, frame.depth - 1))
+                store();
+        }
+    }
+
+private:
+    struct Frame {
+        json::const_iterator it;
+        json::const_iterator end;
+        int depth; // maxDepth of the table
+        bool isObject;
+        lua_Integer next; // next array index
+    };
+
+    lua_State* L;
+    std::vector<Frame> _frames;
+
+    // stores the value at the top of the stack into the table of the top frame
+    void store()
+    {
+        if (_frames.empty())
+            return; // root value stays on the stack
+        Frame& frame = _frames.back();
+        if (frame.isObject)
+            lua_rawset(L, -3); // key was pushed before the value
+        else
+            lua_rawseti(L, -2, static_cast<int>(frame.next++)); // rawseti takes an int before Lua 5.3
+    }
+
+    // pushes a non-container value or starts converting a container
+    // returns true if a frame was started, the table will be stored in the parent when it is done
+    bool value(const json& j, const int maxDepth)
+    {
+        // the parent frame reserved stack space for this value
+        switch (j.type()) {
+            case json::value_t::number_unsigned:
+                if ((sizeof(lua_Integer) >= 8 && j.get<uint64_t>() <= INT64_MAX) || j.get<uint64_t>() <= INT32_MAX) {
+                    lua_pushinteger(L, j);
+                } else {
+                    lua_pushnumber(L, j);
+                }
+                return false;
+            case json::value_t::number_integer:
+                if (sizeof(lua_Integer) >= 8 || (j.get<int64_t>() <= INT32_MAX && j.get<int64_t>() >= INT32_MIN)) {
+                    lua_pushinteger(L, j);
+                } else {
+                    lua_pushnumber(L, j);
+                }
+                return false;
+            case json::value_t::number_float:
                 lua_pushnumber(L, j);
+                return false;
+            case json::value_t::boolean:
+                lua_pushboolean(L, j);
+                return false;
+            case json::value_t::string:
+            {
+                const auto& s = j.get_ref<const json::string_t&>();
+                lua_pushlstring(L, s.data(), s.size());
+                return false;
             }
-            break;
-        case json::value_t::number_float:
-            lua_pushnumber(L, j);
-            break;
-        case json::value_t::boolean:
-            lua_pushboolean(L, j);
-            break;
-        case json::value_t::string:
-            lua_pushstring(L, j.get<std::string>().c_str());
-            break;
-        case json::value_t::null:
-            lua_pushnil(L);
-            break;
-        case json::value_t::object:
-            if (maxDepth == 1)
-                JSON_TO_LUA_MAX_DEPTH_REACHED();
-            if (!lua_checkstack(L, 2))
-                JSON_TO_LUA_STACK_OVERFLOW();
-            lua_newtable(L);
-            for (auto it = j.begin(); it != j.end(); ++it) {
+            case json::value_t::null:
+                lua_pushnil(L);
+                return false;
+            case json::value_t::object:
+            case json::value_t::array:
+            {
+                const size_t frames = _frames.size();
+                container(j, maxDepth);
+                return _frames.size() != frames;
+            }
+            default:
+                // not implemented
+                fprintf(stderr, "Warning: unhandled type %d %s in json_to_lua()\n",
+                        static_cast<int>(j.type()), j.type_name());
+                lua_pushnil(L);
+                return false;
+        }
+    }
+
+    // pushes a new table and a frame for j, or nil if j can't be converted
+    void container(const json& j, const int maxDepth)
+    {
+        if (maxDepth == 1)
+            JSON_TO_LUA_MAX_DEPTH_REACHED();
+        if (!lua_checkstack(L, 3)) // table, key, value
+            JSON_TO_LUA_STACK_OVERFLOW();
+        // presize so the table does not rehash while filling it
+        const int size = j.size() < INT_MAX ? static_cast<int>(j.size()) : INT_MAX;
+        if (j.is_object())
+            lua_createtable(L, 0, size);
+        else
+            lua_createtable(L, size, 0);
+        _frames.push_back({j.cbegin(), j.cend(), maxDepth, j.is_object(), 1});
+    }
+};
+
+static void json_to_lua(lua_State* L, const json& j, const int maxDepth = 1000)
+{
+    JsonToLuaConverter converter(L);
 #ifdef LUA_JSON_HAS_EXCEPTIONS
-                try {
-                    json_to_lua(L, it.value(), maxDepth - 1);
-                } catch (...) {
-                    lua_pop(L, 1);
-                    throw;
-                }
+    const int top = lua_gettop(L);
+    try {
+        converter.convert(j, maxDepth);
+    } catch (...) {
+        lua_settop(L, top);
+        throw;
+    }
 #else
-                json_to_lua(L, it.value(), maxDepth - 1);
+    converter.convert(j, maxDepth);
 #endif
-                lua_setfield(L, -2, it.key().c_str());
-            }
-            break;
-        case json::value_t::array:
-            if (maxDepth == 1)
-                JSON_TO_LUA_MAX_DEPTH_REACHED();
-            if (!lua_checkstack(L, 3))
-                JSON_TO_LUA_STACK_OVERFLOW();
-            lua_newtable(L);
-            for (size_t i = 0; i < j.size(); i++) {
-                if (sizeof(i) < sizeof(lua_Integer)
-                        || i < static_cast<size_t>(std::numeric_limits<lua_Integer>::max()))
-                    lua_pushinteger(L, static_cast<lua_Integer>(i) + 1);
-                else
-                    lua_pushnumber(L, static_cast<lua_Number>(i) + 1);
+}
+
+// nlohmann::json SAX handler that builds Lua values while parsing, see json_text_to_lua
+// containers are created on the Lua stack and a finished value is stored into its parent right away
+class LuaJsonSaxHandler {
+public:
+    LuaJsonSaxHandler(lua_State* L, const int maxDepth)
+        : L(L), _maxDepth(maxDepth)
+    {
+    }
+
+    bool null()
+    {
+        if (_skip)
+            return true;
+        if (!lua_checkstack(L, 1)) // only fails for the root value, start() reserves space for the values of containers
+            JSON_TEXT_TO_LUA_VALUE_STACK_OVERFLOW();
+        lua_pushnil(L);
+        return store();
+    }
+
+    bool boolean(bool val)
+    {
+        if (_skip)
+            return true;
+        if (!lua_checkstack(L, 1))
+            JSON_TEXT_TO_LUA_VALUE_STACK_OVERFLOW();
+        lua_pushboolean(L, val);
+        return store();
+    }
+
+    bool number_integer(json::number_integer_t val)
+    {
+        if (_skip)
+            return true;
+        if (!lua_checkstack(L, 1))
+            JSON_TEXT_TO_LUA_VALUE_STACK_OVERFLOW();
+        // same as json_to_lua
+        if (sizeof(lua_Integer) >= 8 || (val <= INT32_MAX && val >= INT32_MIN))
+            lua_pushinteger(L, static_cast<lua_Integer>(val));
+        else
+            lua_pushnumber(L, static_cast<lua_Number>(val));
+        return store();
+    }
+
+    bool number_unsigned(json::number_unsigned_t val)
+    {
+        if (_skip)
+            return true;
+        if (!lua_checkstack(L, 1))
+            JSON_TEXT_TO_LUA_VALUE_STACK_OVERFLOW();
+        // same as json_to_lua
+        if ((sizeof(lua_Integer) >= 8 && val <= INT64_MAX) || val <= INT32_MAX)
+            lua_pushinteger(L, static_cast<lua_Integer>(val));
+        else
+            lua_pushnumber(L, static_cast<lua_Number>(val));
+        return store();
+    }
+
+    bool number_float(json::number_float_t val, const json::string_t&)
+    {
+        if (_skip)
+            return true;
+        if (!lua_checkstack(L, 1))
+            JSON_TEXT_TO_LUA_VALUE_STACK_OVERFLOW();
+        lua_pushnumber(L, static_cast<lua_Number>(val));
+        return store();
+    }
+
+    bool string(json::string_t& val)
+    {
+        if (_skip)
+            return true;
+        if (!lua_checkstack(L, 1))
+            JSON_TEXT_TO_LUA_VALUE_STACK_OVERFLOW();
+        lua_pushlstring(L, val.data(), val.size());
+        return store();
+    }
+
+#if NLOHMANN_JSON_VERSION_MAJOR > 3 || (NLOHMANN_JSON_VERSION_MAJOR == 3 && NLOHMANN_JSON_VERSION_MINOR >= 8)
+    bool binary(json::binary_t&)
+    {
+        // can't appear in JSON text
+        return null();
+    }
+#endif
+
+    bool start_object(std::size_t)
+    {
+        return start(false);
+    }
+
+    bool key(json::string_t& val)
+    {
+        if (_skip)
+            return true;
+        lua_pushlstring(L, val.data(), val.size()); // start() reserved the stack space
+        return true;
+    }
+
+    bool end_object()
+    {
+        return end();
+    }
+
+    bool start_array(std::size_t)
+    {
+        return start(true);
+    }
+
+    bool end_array()
+    {
+        return end();
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex)
+    {
 #ifdef LUA_JSON_HAS_EXCEPTIONS
-                try {
-                    json_to_lua(L, j[i], maxDepth - 1);
-                } catch (...) {
-                    lua_pop(L, 2);
-                    throw;
-                }
+        // throw the same exception json::parse would throw
+        if (ex.id >= 400 && ex.id < 500)
+            throw *static_cast<const nlohmann::detail::out_of_range*>(&ex);
+        throw *static_cast<const nlohmann::detail::parse_error*>(&ex);
 #else
-                json_to_lua(L, j[i], maxDepth - 1);
+        fprintf(stderr, "Warning: %s in json_text_to_lua. Returning nil.\n", ex.what());
+        return false;
 #endif
-                lua_settable(L, -3);
-            }
-            break;
-        default:
-            // not implemented
-            fprintf(stderr, "Warning: unhandled type %d %s in json_to_lua()\n",
-                    static_cast<int>(j.type()), j.type_name());
+    }
+
+private:
+    struct Container {
+        bool isArray;
+        lua_Integer next; // next array index
+    };
+
+    lua_State* L;
+    const int _maxDepth;
+    std::vector<Container> _containers;
+    size_t _skip = 0; // > 0 while skipping a container that is too deep
+
+    // stores the value at the top of the stack into the container below it
+    bool store()
+    {
+        if (_containers.empty())
+            return true; // root value stays on the stack
+        auto& container = _containers.back();
+        if (container.isArray)
+            lua_rawseti(L, -2, container.next++);
+        else
+            lua_rawset(L, -3); // key was pushed by key()
+        return true;
+    }
+
+    bool start(bool isArray)
+    {
+        if (_skip) {
+            _skip++;
+            return true;
+        }
+        // same limit as json_to_lua: root is called with maxDepth and each level decrements it
+        if (_maxDepth - static_cast<int>(_containers.size()) == 1)
+            JSON_TEXT_TO_LUA_MAX_DEPTH_REACHED();
+        if (!lua_checkstack(L, 3)) // table, key, value
+            JSON_TEXT_TO_LUA_STACK_OVERFLOW();
+        lua_newtable(L);
+        _containers.push_back({isArray, 1});
+        return true;
+    }
+
+    bool end()
+    {
+        if (_skip) {
+            _skip--;
+            return true;
+        }
+        _containers.pop_back();
+        return store();
+    }
+
+#ifndef LUA_JSON_HAS_EXCEPTIONS
+    // called by start() instead of creating the container, its value is nil and its content is ignored
+    bool skip()
+    {
+        if (_containers.empty()) {
+            // root value, may fail if start() ran out of stack
+            if (!lua_checkstack(L, 1))
+                return false;
             lua_pushnil(L);
-            break;
+        } else if (_containers.back().isArray) {
+            _containers.back().next++; // leave the element nil
+        } else {
+            lua_pop(L, 1); // key pushed by key(), the field stays nil
+        }
+        _skip = 1;
+        return true;
+    }
+#endif
+};
+
+// parses JSON text and pushes the result to the Lua stack without creating json first
+// returns false and pushes nil for invalid JSON if exceptions are disabled, otherwise throws json::parse_error
+// Containers that are nested too deep or don't fit on the Lua stack are nil (or throw std::runtime_error), if the
+// root value doesn't fit, false is returned without pushing anything
+static bool json_text_to_lua(lua_State* L, const char* data, const size_t len, const int maxDepth = 1000)
+{
+    const int top = lua_gettop(L);
+    LuaJsonSaxHandler handler(L, maxDepth);
+#ifdef LUA_JSON_HAS_EXCEPTIONS
+    try {
+        json::sax_parse(data, data + len, &handler);
+    } catch (...) {
+        lua_settop(L, top);
+        throw;
+    }
+    return true;
+#else
+    if (!json::sax_parse(data, data + len, &handler)) {
+        lua_settop(L, top);
+        if (lua_checkstack(L, 1)) // not if parsing failed for a stack overflow
+            lua_pushnil(L);
+        return false;
     }
+    return true;
+#endif
 }
 
+#if __cplusplus >= 201703L
+static bool json_text_to_lua(lua_State* L, const std::string_view text, const int maxDepth = 1000)
+{
+    return json_text_to_lua(L, text.data(), text.size(), maxDepth);
+}
+#endif
+
 
 #undef LUA_JSON_HAS_EXCEPTIONS
 #undef LUA_TO_JSON_MAX_DEPTH_REACHED
 #undef LUA_TO_JSON_STACK_OVERFLOW
+#undef LUA_TO_JSON_CYCLE_DETECTED
 #undef JSON_TO_LUA_STACK_OVERFLOW
+#undef JSON_TEXT_TO_LUA_MAX_DEPTH_REACHED
+#undef JSON_TEXT_TO_LUA_STACK_OVERFLOW
+#undef JSON_TEXT_TO_LUA_VALUE_STACK_OVERFLOW
+#undef LUA_TO_JSON_WRITE_MAX_DEPTH_REACHED
+#undef LUA_TO_JSON_WRITE_STACK_OVERFLOW
+#undef LUA_TO_JSON_WRITE_CYCLE_DETECTED
 
 #endif /* LUAJSON_H */
 
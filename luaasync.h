@@ -0,0 +1,591 @@
+#ifndef _LUAGLUE_LUAASYNC_H
+#define _LUAGLUE_LUAASYNC_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "lua_include.h"
+#include "luacompat.h"
+#include "luamethod.h"
+
+#if defined __cpp_exceptions || defined __EXCEPTIONS || defined _CPPUNWIND
+#   define LUAASYNC_HAS_EXCEPTIONS
+#endif
+
+// bound methods that return LuaAsync<R> or std::future<R> suspend the calling coroutine until the result is
+// available, without blocking the thread that runs the interpreter:
+//   LuaAsync<json> Fetch(std::string_view url) { return LuaAsync<json>([url = std::string(url)] { return get(url); }); }
+//   LUA_METHOD(Client, Fetch, std::string_view)
+//   LuaAsyncScheduler scheduler(L, 4); // 4 worker threads
+//   // in the host's main loop, on the thread that owns L
+//   scheduler.Pump();
+// LuaAsync work runs on the executor of the scheduler (its thread pool by default), std::future results are
+// polled. Pump resumes each coroutine whose result is ready with the result pushed like a return value
+// (Lua::Push, json as table), so in Lua the call looks synchronous:
+//   local page = client:Fetch("http://...")
+// Failed work (LuaResult error, exception) is returned as nil, message. LuaResult<void> returns true on success.
+// The work runs on another thread, so it must capture arguments by value (std::string instead of const char* or std::string_view)
+// and must not use the lua_State. Calls from the main thread instead of a coroutine raise a Lua error without
+// starting the work, see LuaAsyncScheduler::Spawn to run a function in a new coroutine.
+
+// fixed number of threads running posted work in FIFO order
+class LuaThreadPool final {
+public:
+    // threads = 0 uses std::thread::hardware_concurrency()
+    explicit LuaThreadPool(size_t threads = 0)
+    {
+        if (threads == 0)
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        _threads.reserve(threads);
+        for (size_t i = 0; i < threads; i++)
+            _threads.emplace_back([this] { Run(); });
+    }
+
+    LuaThreadPool(const LuaThreadPool&) = delete;
+    LuaThreadPool& operator=(const LuaThreadPool&) = delete;
+
+    // runs all work that was posted before and joins the threads
+    ~LuaThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        for (auto& thread: _threads)
+            thread.join();
+    }
+
+    void Post(std::function<void()> work)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.push_back(std::move(work));
+        }
+        _cv.notify_one();
+    }
+
+    size_t size() const
+    {
+        return _threads.size();
+    }
+
+private:
+    void Run()
+    {
+        for (;;) {
+            std::function<void()> work;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv.wait(lock, [this] { return _stop || !_queue.empty(); });
+                if (_queue.empty())
+                    return;
+                work = std::move(_queue.front());
+                _queue.pop_front();
+            }
+            work();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<std::function<void()>> _queue;
+    bool _stop = false;
+    std::vector<std::thread> _threads;
+};
+
+// work for the scheduler's executor, returning R or LuaResult<R> (void or LuaResult<void> for no value)
+template <typename R>
+class LuaAsync final {
+public:
+    template <typename F, typename std::enable_if<!std::is_same<typename std::decay<F>::type, LuaAsync>::value,
+            int>::type = 0>
+    explicit LuaAsync(F&& work)
+    {
+        if constexpr (std::is_void<decltype(work())>::value)
+            _work = [work = std::forward<F>(work)]() mutable { work(); return LuaResult<void>(); };
+        else
+            _work = std::forward<F>(work);
+    }
+
+    // runs the work on the calling thread, exceptions are returned as LuaError
+    LuaResult<R> Run()
+    {
+#ifdef LUAASYNC_HAS_EXCEPTIONS
+        try {
+            return _work();
+        } catch (const std::exception& e) {
+            return LuaError(e.what());
+        } catch (...) {
+            return LuaError("unknown exception");
+        }
+#else
+        return _work();
+#endif
+    }
+
+private:
+    std::function<LuaResult<R>()> _work;
+};
+
+namespace LuaGlue {
+
+// LuaResult for the value of a std::future<R>
+template <typename R>
+struct async_result {
+    using type = LuaResult<R>;
+};
+
+template <typename R>
+struct async_result<LuaResult<R>> {
+    using type = LuaResult<R>;
+};
+
+// get() of a ready future, exceptions are returned as LuaError
+template <typename R>
+typename async_result<R>::type future_result(std::future<R>& future)
+{
+#ifdef LUAASYNC_HAS_EXCEPTIONS
+    try {
+#endif
+        if constexpr (std::is_void<R>::value) {
+            future.get();
+            return LuaResult<void>();
+        } else {
+            return future.get();
+        }
+#ifdef LUAASYNC_HAS_EXCEPTIONS
+    } catch (const std::exception& e) {
+        return LuaError(e.what());
+    } catch (...) {
+        return LuaError("unknown exception");
+    }
+#endif
+}
+
+// pushes the values a coroutine is resumed with, returns the number of values pushed
+template <typename V>
+int push_async_results(lua_State *L, const LuaResult<V>& res)
+{
+    luaL_checkstack(L, 2, "too many results");
+    if (!res) {
+        lua_pushnil(L);
+        lua_pushlstring(L, res.error().data(), res.error().size());
+        return 2;
+    }
+    if constexpr (std::is_void<V>::value) {
+        lua_pushboolean(L, 1);
+        return 1;
+    } else {
+        return push_results(L, res);
+    }
+}
+
+} // namespace LuaGlue
+
+// resumes coroutines waiting for LuaAsync or std::future results of bound methods, see above
+// One scheduler per lua_State, it must be destroyed before the state is closed. All methods, except the notify
+// callback, are used on the thread that owns the state. Coroutines waiting for a result must not be resumed by
+// anyone else.
+class LuaAsyncScheduler final {
+public:
+    using Executor = std::function<void(std::function<void()>)>;
+    using ErrorHandler = std::function<void(lua_State *co, const char *msg)>;
+
+    // runs work on an own thread pool with threads threads, 0 = std::thread::hardware_concurrency()
+    explicit LuaAsyncScheduler(lua_State *L, size_t threads = 0)
+        : _L(L), _pool(new LuaThreadPool(threads))
+    {
+        LuaThreadPool *pool = _pool.get();
+        _executor = [pool](std::function<void()> work) { pool->Post(std::move(work)); };
+        Register();
+    }
+
+    // runs work through executor, e.g. the host's thread pool, the work may also run inline
+    LuaAsyncScheduler(lua_State *L, Executor executor)
+        : _L(L), _executor(std::move(executor))
+    {
+        Register();
+    }
+
+    LuaAsyncScheduler(const LuaAsyncScheduler&) = delete;
+    LuaAsyncScheduler& operator=(const LuaAsyncScheduler&) = delete;
+
+    // waiting coroutines are released without being resumed, work that is running or queued in the own
+    // thread pool is finished first
+    ~LuaAsyncScheduler()
+    {
+        for (auto& job: _jobs)
+            luaL_unref(_L, LUA_REGISTRYINDEX, job.second.ref);
+        if (Get(_L) == this) {
+            lua_pushlightuserdata(_L, RegistryKey());
+            lua_pushnil(_L);
+            lua_rawset(_L, LUA_REGISTRYINDEX);
+        }
+        _pool.reset();
+    }
+
+    // scheduler of L or of the state L is a coroutine of, nullptr if there is none
+    static LuaAsyncScheduler* Get(lua_State *L)
+    {
+        lua_pushlightuserdata(L, RegistryKey());
+        lua_rawget(L, LUA_REGISTRYINDEX);
+        auto self = static_cast<LuaAsyncScheduler *>(lua_touserdata(L, -1));
+        lua_pop(L, 1);
+        return self;
+    }
+
+    // resumes all coroutines whose result is ready, returns the number of coroutines resumed
+    // If nothing is ready, waits up to timeout for a result, e.g. for hosts without a main loop of their own
+    int Pump(std::chrono::milliseconds timeout = std::chrono::milliseconds(0))
+    {
+        if (timeout.count() > 0 && _ready.empty() && !_jobs.empty())
+            Wait(timeout);
+        {
+            std::lock_guard<std::mutex> lock(_done->mutex);
+            _ready.insert(_ready.end(), _done->ids.begin(), _done->ids.end());
+            _done->ids.clear();
+        }
+        for (size_t i = 0; i < _polled.size();) {
+            if (_jobs.at(_polled[i]).ready()) {
+                _ready.push_back(_polled[i]);
+                _polled[i] = _polled.back();
+                _polled.pop_back();
+            } else {
+                i++;
+            }
+        }
+        // only the jobs ready now, resumed coroutines may start new async calls
+        // the others stay queued if the error handler throws, and are resumed by the next Pump
+        int resumed = 0;
+        for (size_t n = _ready.size(); n > 0; n--) {
+            const uint64_t id = _ready.front();
+            _ready.pop_front();
+            resumed += Resume(id);
+        }
+        return resumed;
+    }
+
+    // runs the function below nargs arguments at the top of the stack in a new coroutine, like coroutine.wrap(f)(...)
+    // returns false if it failed, the error is passed to the error handler
+    bool Spawn(int nargs = 0)
+    {
+        lua_State *co = lua_newthread(_L);
+        lua_insert(_L, -(nargs + 2));
+        lua_xmove(_L, co, nargs + 1);
+        int nres = 0;
+        const int status = lua_resume(co, _L, nargs, &nres);
+        const bool ok = status == LUA_OK || status == LUA_YIELD;
+        if (ok)
+            lua_pop(co, nres);
+        else
+            Error(co);
+        lua_pop(_L, 1);
+        return ok;
+    }
+
+    // number of coroutines waiting for a result
+    size_t pending() const
+    {
+        return _jobs.size();
+    }
+
+    // called with the coroutine and message when a resumed coroutine fails, prints a warning by default
+    void SetErrorHandler(ErrorHandler handler)
+    {
+        _onError = std::move(handler);
+    }
+
+    // called on the executor's thread when LuaAsync work finished, e.g. to wake up the host's main loop
+    // to call Pump. Has to be set before work is started.
+    void SetNotify(std::function<void()> notify)
+    {
+        _done->notify = std::move(notify);
+    }
+
+    // starts the work for a bound method, see LuaGlue::async_traits
+    // returns the yield code or RaiseError with the message pushed
+    template <typename R>
+    static int Start(lua_State *L, LuaAsync<R>&& async)
+    {
+        LuaAsyncScheduler *self = Check(L);
+        if (!self)
+            return LuaGlue::RaiseError;
+        auto result = std::make_shared<std::optional<LuaResult<R>>>();
+        const uint64_t id = self->Add(L, [result](lua_State *co) {
+            return LuaGlue::push_async_results(co, **result);
+        });
+        // the result is published to Pump through the mutex of done
+#ifdef LUAASYNC_HAS_EXCEPTIONS
+        try {
+#endif
+            self->_executor([work = std::move(async), result, done = self->_done, id]() mutable {
+                result->emplace(work.Run());
+                done->Complete(id);
+            });
+#ifdef LUAASYNC_HAS_EXCEPTIONS
+        } catch (...) {
+            // never completes, the method raises the error instead
+            self->Remove(id);
+            throw;
+        }
+#endif
+        return LuaGlue::yield_results(0);
+    }
+
+    template <typename R>
+    static int Start(lua_State *L, std::future<R>&& future)
+    {
+        if (!future.valid())
+            return LuaGlue::push_error(L, "invalid future");
+        LuaAsyncScheduler *self = Check(L);
+        if (!self)
+            return LuaGlue::RaiseError;
+        // std::function needs a copyable future
+        auto shared = std::make_shared<std::future<R>>(std::move(future));
+        const uint64_t id = self->Add(L, [shared](lua_State *co) {
+            return LuaGlue::push_async_results(co, LuaGlue::future_result(*shared));
+        });
+        // deferred futures are ready, get() runs them on the owner's thread
+        self->_jobs.at(id).ready = [shared]() {
+            return shared->wait_for(std::chrono::seconds(0)) != std::future_status::timeout;
+        };
+        self->_polled.push_back(id);
+        return LuaGlue::yield_results(0);
+    }
+
+private:
+    struct Job {
+        int ref = LUA_NOREF; // keeps the coroutine alive
+        lua_State *co = nullptr;
+        std::function<bool()> ready; // polled, LuaAsync work reports to Done instead
+        std::function<int(lua_State *co)> push;
+    };
+
+    // shared with work that may finish after the scheduler is destroyed
+    struct Done {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<uint64_t> ids;
+        std::function<void()> notify;
+
+        void Complete(uint64_t id)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ids.push_back(id);
+            }
+            cv.notify_one();
+            if (notify)
+                notify();
+        }
+    };
+
+    static void* RegistryKey()
+    {
+        static const char key = 0;
+        return const_cast<char *>(&key);
+    }
+
+    void Register()
+    {
+        lua_pushlightuserdata(_L, RegistryKey());
+        lua_pushlightuserdata(_L, this);
+        lua_rawset(_L, LUA_REGISTRYINDEX);
+    }
+
+    // scheduler of the coroutine L, or nullptr with the error pushed
+    static LuaAsyncScheduler* Check(lua_State *L)
+    {
+        LuaAsyncScheduler *self = Get(L);
+        if (!self)
+            LuaGlue::push_error(L, "no LuaAsyncScheduler for this state");
+        else if (!lua_isyieldable(L))
+            LuaGlue::push_error(L, "attempt to yield from outside a coroutine");
+        else
+            return self;
+        return nullptr;
+    }
+
+    uint64_t Add(lua_State *co, std::function<int(lua_State *co)> push)
+    {
+        Job job;
+        lua_pushthread(co);
+        job.ref = luaL_ref(co, LUA_REGISTRYINDEX);
+        job.co = co;
+        job.push = std::move(push);
+        const uint64_t id = _nextId++;
+        _jobs.emplace(id, std::move(job));
+        return id;
+    }
+
+    // waits until LuaAsync work finished or a std::future is ready, futures are polled every millisecond
+    void Wait(std::chrono::milliseconds timeout)
+    {
+        const auto until = std::chrono::steady_clock::now() + timeout;
+        std::unique_lock<std::mutex> lock(_done->mutex);
+        while (_done->ids.empty()) {
+            for (uint64_t id: _polled)
+                if (_jobs.at(id).ready())
+                    return;
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= until)
+                return;
+            auto wait = until - now;
+            if (!_polled.empty())
+                wait = std::min<std::chrono::steady_clock::duration>(wait, std::chrono::milliseconds(1));
+            _done->cv.wait_for(lock, wait);
+        }
+    }
+
+    void Remove(uint64_t id)
+    {
+        const auto job = _jobs.find(id);
+        luaL_unref(_L, LUA_REGISTRYINDEX, job->second.ref);
+        _jobs.erase(job);
+    }
+
+    // releases the coroutine of a job, also if the error handler throws
+    struct JobRef {
+        lua_State *L;
+        int ref;
+
+        ~JobRef()
+        {
+            luaL_unref(L, LUA_REGISTRYINDEX, ref);
+        }
+    };
+
+    // resumes the coroutine of job id with its results, returns 1 if it was resumed
+    int Resume(uint64_t id)
+    {
+        const auto it = _jobs.find(id);
+        if (it == _jobs.end())
+            return 0;
+        Job job = std::move(it->second);
+        _jobs.erase(it);
+        const JobRef ref{_L, job.ref};
+        lua_State *co = job.co;
+        if (lua_status(co) != LUA_YIELD) {
+            Report(co, "coroutine waiting for an async result is not suspended");
+            return 0;
+        }
+        const int narg = PushResults(co, job);
+        if (narg < 0) {
+            Report(co, "no stack space for the async results");
+            return 0;
+        }
+        int nres = 0;
+        const int status = lua_resume(co, _L, narg, &nres);
+        if (status == LUA_OK || status == LUA_YIELD)
+            lua_pop(co, nres);
+        else
+            Error(co);
+        return 1;
+    }
+
+    // pushes the results of job onto co, returns the number of values pushed or -1 if co has no stack space
+    // The values are converted in protected mode on the owner's thread and moved to the suspended co. If that
+    // fails, e.g. with a too deep json, co is resumed with nil and the message instead.
+    int PushResults(lua_State *co, Job& job)
+    {
+        const int top = lua_gettop(_L);
+        if (!lua_checkstack(_L, 2))
+            return -1;
+        lua_pushcfunction(_L, PushProtected);
+        lua_pushlightuserdata(_L, &job);
+        if (lua_pcall(_L, 1, LUA_MULTRET, 0) != LUA_OK) {
+            lua_pushnil(_L);
+            lua_insert(_L, -2);
+        }
+        const int n = lua_gettop(_L) - top;
+        if (!lua_checkstack(co, n)) {
+            lua_settop(_L, top);
+            return -1;
+        }
+        lua_xmove(_L, co, n);
+        return n;
+    }
+
+    static int PushProtected(lua_State *L)
+    {
+        Job *job = static_cast<Job *>(lua_touserdata(L, 1));
+        lua_pop(L, 1);
+#ifdef LUAASYNC_HAS_EXCEPTIONS
+        try {
+            return job->push(L);
+        } catch (const std::exception& e) {
+            lua_pushstring(L, e.what());
+        } catch (...) {
+            lua_pushliteral(L, "unknown exception");
+        }
+        // the exception is destroyed at this point, so the longjmp does not skip it
+        return lua_error(L);
+#else
+        return job->push(L);
+#endif
+    }
+
+    // reports and pops the error message at the top of co
+    void Error(lua_State *co)
+    {
+        const char *msg = lua_tostring(co, -1);
+        Report(co, msg ? msg : "(error object is not a string)");
+        lua_pop(co, 1);
+    }
+
+    void Report(lua_State *co, const char *msg)
+    {
+        if (_onError)
+            _onError(co, msg);
+        else
+            fprintf(stderr, "Warning: async coroutine failed: %s\n", msg);
+    }
+
+    lua_State *_L;
+    Executor _executor;
+    ErrorHandler _onError;
+    std::shared_ptr<Done> _done = std::make_shared<Done>();
+    std::unordered_map<uint64_t, Job> _jobs;
+    std::vector<uint64_t> _polled; // jobs with ready()
+    std::deque<uint64_t> _ready; // jobs to resume, in the order they became ready
+    uint64_t _nextId = 0;
+    std::unique_ptr<LuaThreadPool> _pool; // destroyed first, finishes running work
+};
+
+namespace LuaGlue {
+
+template <typename R>
+struct async_traits<LuaAsync<R>> : std::true_type {
+    static int start(lua_State *L, LuaAsync<R>&& async)
+    {
+        return LuaAsyncScheduler::Start(L, std::move(async));
+    }
+};
+
+template <typename R>
+struct async_traits<std::future<R>> : std::true_type {
+    static int start(lua_State *L, std::future<R>&& future)
+    {
+        return LuaAsyncScheduler::Start(L, std::move(future));
+    }
+};
+
+} // namespace LuaGlue
+
+#endif // _LUAGLUE_LUAASYNC_H
@@ -10,6 +10,11 @@
 #include <limits>
 #include "lua_include.h"
 
+// LuaJIT reports LUA_VERSION_NUM 501, but already provides some of the 5.2 API that we add for 5.1 below
+// lualib.h of LuaJIT always defines LUA_JITLIBNAME
+#if LUA_VERSION_NUM == 501 && defined LUA_JITLIBNAME
+#define LUACOMPAT_LUAJIT 1
+#endif
 
 #if LUA_VERSION_NUM < 503
 static int lua_isinteger(lua_State *L, int idx)
@@ -43,15 +48,66 @@ static int lua_geti(lua_State *L, int index, const lua_Integer i)
 }
 #endif
 
+#if LUA_VERSION_NUM < 503 && !defined LUACOMPAT_LUAJIT
+// only tells main thread from coroutine. Lua 5.1 still errors when yielding across pcall or metamethods
+static int lua_isyieldable(lua_State *L)
+{
+    const int isMain = lua_pushthread(L);
+    lua_pop(L, 1);
+    return !isMain;
+}
+#endif
+
+#if LUA_VERSION_NUM < 504
+// 5.4 signature. The values yielded or returned are the only values on the stack of L after this
+static int lua_resume(lua_State *L, lua_State *from, int narg, int *nres)
+{
 #if LUA_VERSION_NUM < 502
+    (void)from;
+    const int res = lua_resume(L, narg);
+#else
+    const int res = lua_resume(L, from, narg);
+#endif
+    *nres = lua_gettop(L);
+    return res;
+}
+#endif
+
+#if LUA_VERSION_NUM < 502
+static int lua_absindex(lua_State *L, int idx)
+{
+    return (idx > 0 || idx <= LUA_REGISTRYINDEX) ? idx : lua_gettop(L) + idx + 1;
+}
+
+static void lua_rawgetp(lua_State *L, int idx, const void *p)
+{
+    idx = lua_absindex(L, idx);
+    lua_pushlightuserdata(L, const_cast<void*>(p));
+    lua_rawget(L, idx);
+}
+
+static void lua_rawsetp(lua_State *L, int idx, const void *p)
+{
+    idx = lua_absindex(L, idx);
+    lua_pushlightuserdata(L, const_cast<void*>(p));
+    lua_insert(L, -2);
+    lua_rawset(L, idx);
+}
+
 // NOTE: lua_objlen was renamed to lua_len in 5.2, so we can't use the same code everywhere
 static lua_Integer luaL_len(lua_State *L, int idx)
 {
     return (lua_Integer)lua_objlen(L, idx);
 }
 
+static size_t lua_rawlen(lua_State *L, int idx)
+{
+    return lua_objlen(L, idx);
+}
+
 #define luaL_getmetatable(L,n)  (lua_getfield(L, LUA_REGISTRYINDEX, (n)))
 
+#ifndef LUACOMPAT_LUAJIT
 static void luaL_setmetatable (lua_State *L, const char *tname) {
     luaL_getmetatable(L, tname);
     lua_setmetatable(L, -2);
@@ -71,6 +127,23 @@ static void *luaL_testudata (lua_State *L, int ud, const char *tname) {
   }
   return NULL;  /* to avoid warnings */
 }
+
+static lua_Number lua_tonumberx(lua_State *L, int idx, int *isnum)
+{
+    lua_Number n = lua_tonumber(L, idx);
+    if (isnum)
+        *isnum = n != 0 || lua_isnumber(L, idx);
+    return n;
+}
+
+static lua_Integer lua_tointegerx(lua_State *L, int idx, int *isnum)
+{
+    lua_Integer n = lua_tointeger(L, idx);
+    if (isnum)
+        *isnum = n != 0 || lua_isnumber(L, idx);
+    return n;
+}
+#endif // LUACOMPAT_LUAJIT
 #endif
 
 #ifndef LUA_OK
@@ -13,7 +13,7 @@ public:
     {
     }
 
-    void Lua_Push(lua_State *L)
+    void Lua_Push(lua_State *L) const
     {
         lua_createtable(L, 0, _values.size());
         for (const auto& pair: _values)
@@ -24,7 +24,7 @@ public:
         }
     }
 
-    void Lua_SetGlobal(lua_State *L, const char* name)
+    void Lua_SetGlobal(lua_State *L, const char* name) const
     {
         Lua_Push(L);
         lua_setglobal(L, name);
@@ -1,30 +1,138 @@
 #ifndef _LUAGLUE_LUAINTERFACE_H
 #define _LUAGLUE_LUAINTERFACE_H
 
-#include <map> // TODO: write a constexpr_map for MethodMap instead
+#include <map>
+#include <memory>
+#include <new>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 #include "luatype.h"
 #include "lua_include.h"
+#include "luacompat.h"
+#include "_constexpr_map.h"
 
 
 /* Magic to get a c++ object into lua */
 /* you need to declare static Lua_Methods and static Lua_Name in your class */
+/* Lua_Methods can be a MethodMap or (preferred) a constexpr ConstMethodMap created with MakeMethodMap */
+/* optionally declare static constexpr bool Lua_CacheInstances = true to reuse the userdata when pushing
+   the same instance again, see Lua_Push and Lua_Evict */
+/* optionally declare static Lua_Properties created with MakePropertyMap to bind members without
+   overriding Lua_Index and Lua_NewIndex */
 template <class T>
 class LuaInterface : public LuaType {
 private:
+    // userdata block created by Lua_Push, or header of the block created by Lua_New
+    struct Lua_Userdata {
+        T *object; // first member, so this is compatible with T** used by luaL_checkudata
+        const void *tag; // Lua_TypeTag()
+    };
+
+    // unique address per class to identify userdata created by Lua_Push
+    static const void* Lua_TypeTag()
+    {
+        static const char tag = 0;
+        return &tag;
+    }
+
+    // registry key for the weak table object => userdata used if T::Lua_CacheInstances is true
+    // and for all instances created by Lua_New
+    static const void* Lua_CacheKey()
+    {
+        static const char key = 0;
+        return &key;
+    }
+
+    template <class U>
+    static constexpr auto Lua_IsCached(int) -> decltype(U::Lua_CacheInstances)
+    {
+        return U::Lua_CacheInstances;
+    }
+
+    template <class U>
+    static constexpr bool Lua_IsCached(...)
+    {
+        return false;
+    }
+
+    template <class U>
+    static constexpr auto Lua_HasProperties(int) -> decltype(U::Lua_Properties.find(std::string_view()), true)
+    {
+        return true;
+    }
+
+    template <class U>
+    static constexpr bool Lua_HasProperties(...)
+    {
+        return false;
+    }
+
+    // pushes the instance cache table, creates it if it does not exist yet
+    static void Lua_PushCache(lua_State *L)
+    {
+        lua_rawgetp(L, LUA_REGISTRYINDEX, Lua_CacheKey());
+        if (!lua_isnil(L, -1))
+            return;
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_createtable(L, 0, 1);
+        lua_pushliteral(L, "v"); // weak values: the cache does not keep the userdata alive
+        lua_setfield(L, -2, "__mode");
+        lua_setmetatable(L, -2);
+        lua_pushvalue(L, -1);
+        lua_rawsetp(L, LUA_REGISTRYINDEX, Lua_CacheKey());
+    }
+
+    void Lua_PushNew(lua_State *L) const
+    {
+        // create userdata=pointer+tag for this instance
+        auto ud = static_cast<Lua_Userdata *>(lua_newuserdata(L, sizeof(Lua_Userdata)));
+        ud->object = const_cast<T *>(static_cast<const T *>(this));
+        ud->tag = Lua_TypeTag();
+        // set metatable
+        luaL_setmetatable(L, T::Lua_Name);
+#ifdef DEBUG
+        printf("%s instance pushed\n", T::Lua_Name);
+#endif
+    }
+
     static int Lua_IndexWrapper(lua_State *L)
     {
         T *o = luaL_checkthis(L, -2);
-        const char *key = luaL_checkstring(L, -1);
+        size_t len;
+        const char *key = luaL_checklstring(L, -1, &len);
 #ifdef DEBUG
         printf("LuaInterface<%s>::Lua_Index(\"%s\")\n", T::Lua_Name, key);
 #endif
-        auto it = T::Lua_Methods.find(key);
+        auto it = T::Lua_Methods.find(std::string_view(key, len));
         if (it != T::Lua_Methods.end()) {
             lua_pushcfunction(L, it->second);
             return 1;
         }
+        if constexpr (Lua_HasProperties<T>(0)) {
+            auto prop = T::Lua_Properties.find(std::string_view(key, len));
+            if (prop != T::Lua_Properties.end())
+                return prop->second.get ? prop->second.get(L, o) : 0;
+        }
+        return o->Lua_Index(L, key);
+    }
+
+    // __index fallback for IndexMode::MethodTable, only called for non-method keys
+    static int Lua_IndexFallbackWrapper(lua_State *L)
+    {
+        T *o = luaL_checkthis(L, -2);
+        size_t len;
+        const char *key = luaL_checklstring(L, -1, &len);
+#ifdef DEBUG
+        printf("LuaInterface<%s>::Lua_Index(\"%s\")\n", T::Lua_Name, key);
+#endif
+        if constexpr (Lua_HasProperties<T>(0)) {
+            auto prop = T::Lua_Properties.find(std::string_view(key, len));
+            if (prop != T::Lua_Properties.end())
+                return prop->second.get ? prop->second.get(L, o) : 0;
+        }
         return o->Lua_Index(L, key);
     }
 
@@ -32,27 +140,39 @@ private:
     static int Lua_NewIndexWrapper(lua_State *L)
     {
         T *o = luaL_checkthis(L, -3);
-        const char *key = luaL_checkstring(L, -2);
+        size_t len;
+        const char *key = luaL_checklstring(L, -2, &len);
 #ifdef DEBUG
         printf("LuaInterface<%s>::Lua_NewIndex(\"%s\", ...)\n", T::Lua_Name, key);
 #endif
-        auto it = T::Lua_Methods.find(key);
-        if (it != T::Lua_Methods.end()) { // disallow write to method names
-            const std::string msg = std::string("Can't assign to method \"") + key + "\" of \"" + T::Lua_Name + "\"";
-            luaL_error(L, msg.c_str());
-            return 0;
-        }
-        if (!o->Lua_NewIndex(L, key)) {
-            const std::string msg = std::string("Unknown property \"") + key + "\" for \"" + T::Lua_Name + "\"";
-            luaL_error(L, msg.c_str());
-            return 0;
+        auto it = T::Lua_Methods.find(std::string_view(key, len));
+        // errors are formatted by Lua, no C++ objects may be alive when luaL_error jumps out of this function
+        if (it != T::Lua_Methods.end()) // disallow write to method names
+            return luaL_error(L, "Can't assign to method \"%s\" of \"%s\"", key, T::Lua_Name);
+        if constexpr (Lua_HasProperties<T>(0)) {
+            auto prop = T::Lua_Properties.find(std::string_view(key, len));
+            if (prop != T::Lua_Properties.end()) {
+                if (!prop->second.set)
+                    return luaL_error(L, "Can't assign to read-only property \"%s\" of \"%s\"", key, T::Lua_Name);
+                prop->second.set(L, o);
+                return 0;
+            }
         }
+        if (!o->Lua_NewIndex(L, key))
+            return luaL_error(L, "Unknown property \"%s\" for \"%s\"", key, T::Lua_Name);
         return 0;
     }
 
     static int Lua_GCWrapper(lua_State *L) {
         T *o = luaL_checkthis(L, 1);
+        if (!o)
+            return 0;
         o->Lua_GC(L);
+        if (lua_rawlen(L, 1) > sizeof(Lua_Userdata)) {
+            // instance is owned by Lua, see Lua_New
+            o->~T();
+            static_cast<Lua_Userdata *>(lua_touserdata(L, 1))->object = nullptr;
+        }
         return 0;
     }
 
@@ -81,26 +201,110 @@ protected:
 public:
     ~LuaInterface() override = default;
 
+    // name of the metatable, for helpers outside of LuaInterface, since T::Lua_Name is usually protected
+    static constexpr const char* Lua_GetName()
+    {
+        return T::Lua_Name;
+    }
+
     static T* luaL_checkthis(lua_State *L, const int narg)
     {
+        T *o = luaL_testthis(L, narg);
+        if (o)
+            return o;
+        // raises the error, unless this is a userdata that was not created by Lua_Push
         return * static_cast<T **>(luaL_checkudata(L, narg, T::Lua_Name));
     }
 
     static T* luaL_testthis(lua_State *L, const int narg)
     {
+        auto ud = static_cast<const Lua_Userdata *>(lua_touserdata(L, narg));
+        if (!ud)
+            return nullptr;
+        // fast path: compare type tag instead of fetching the metatable by name
+        if (lua_rawlen(L, narg) >= sizeof(Lua_Userdata) && ud->tag == Lua_TypeTag())
+            return ud->object;
+        // slow path: other types, or a userdata that was not created by Lua_Push
         auto p = static_cast<T **>(luaL_testudata(L, narg, T::Lua_Name));
         if (p)
             return *p;
         return nullptr;
     }
 
-    // TODO: replace this by a custom constexpr_map
+    // runtime map name => func, see ConstMethodMap for a faster alternative
     using MethodMap = std::map<const std::string_view,lua_CFunction>;
+
+    // compile time perfect hash map name => func, use as
+    //   static constexpr auto Lua_Methods = MakeMethodMap({LUA_METHOD(...), ...});
+    template <size_t N>
+    using ConstMethodMap = LuaGlue::constexpr_map<lua_CFunction, N>;
+
+    template <size_t N>
+    static constexpr ConstMethodMap<N> MakeMethodMap(const std::pair<std::string_view, lua_CFunction> (&methods)[N])
+    {
+        return ConstMethodMap<N>(methods);
+    }
     
-    static void Lua_Register(lua_State *L) { // create "Class" in Lua
+    // getter and setter of a property, called with (self, key[, value]) on the stack
+    struct Property {
+        int (*get)(lua_State *L, T *o); // pushes the value and returns 1, nullptr if write-only
+        void (*set)(lua_State *L, T *o); // reads the value from index 3, nullptr if read-only
+    };
+
+    // compile time perfect hash map name => property, use as
+    //   static constexpr auto Lua_Properties = MakePropertyMap({LUA_PROPERTY(...), ...});
+    // properties are looked up after methods and before Lua_Index/Lua_NewIndex
+    template <size_t N>
+    using ConstPropertyMap = LuaGlue::constexpr_map<Property, N>;
+
+    template <size_t N>
+    static constexpr ConstPropertyMap<N> MakePropertyMap(const std::pair<std::string_view, Property> (&properties)[N])
+    {
+        return ConstPropertyMap<N>(properties);
+    }
+
+    enum class IndexMode {
+        Function, // __index is a C function that looks up Lua_Methods, then calls Lua_Index
+        MethodTable, // __index is a table filled from Lua_Methods, Lua_Index is only called for other keys
+                     // faster method calls, slower properties and Lua_Index
+    };
+
+    // true if T overrides Lua_Index or has properties, which means __index needs a fallback for non-method keys
+    static constexpr bool HasCustomIndex()
+    {
+        return !std::is_same<decltype(&T::Lua_Index), int (LuaInterface::*)(lua_State*, const char*)>::value
+                || Lua_HasProperties<T>(0);
+    }
+
+    static void Lua_Register(lua_State *L, IndexMode mode = IndexMode::Function) { // create "Class" in Lua
         // create metatable for this class
         luaL_newmetatable(L, T::Lua_Name);
-        lua_pushcfunction(L, Lua_IndexWrapper);
+        if (mode == IndexMode::MethodTable) {
+            // resolve methods inside the Lua VM, no C call and no new function value per lookup
+            lua_createtable(L, 0, static_cast<int>(T::Lua_Methods.size()));
+            for (const auto& method: T::Lua_Methods) {
+                lua_pushlstring(L, method.first.data(), method.first.size());
+                lua_pushcfunction(L, method.second);
+                lua_rawset(L, -3);
+            }
+            if (HasCustomIndex()) {
+                // wrap the table in a Lua closure so Lua_Index still gets the instance for other keys
+                static constexpr char indexChunk[] =
+                        "local methods, fallback = ...\n"
+                        "return function(self, key)\n"
+                        "    local method = methods[key]\n"
+                        "    if method ~= nil then return method end\n"
+                        "    return fallback(self, key)\n"
+                        "end\n";
+                if (luaL_loadbuffer(L, indexChunk, sizeof(indexChunk) - 1, T::Lua_Name) != LUA_OK)
+                    lua_error(L);
+                lua_insert(L, -2); // chunk, methods
+                lua_pushcfunction(L, Lua_IndexFallbackWrapper);
+                lua_call(L, 2, 1);
+            }
+        } else {
+            lua_pushcfunction(L, Lua_IndexWrapper);
+        }
         lua_setfield(L,-2, "__index");
         lua_pushcfunction(L, Lua_NewIndexWrapper);
         lua_setfield(L,-2, "__newindex");
@@ -113,14 +317,74 @@ public:
     }
     
     void Lua_Push(lua_State *L) const override { // pushes instance to Lua stack
-        // create userdata=pointer for this instance
-        auto ud = static_cast<const void **>(lua_newuserdata(L, sizeof(void**)));
-        *ud = this;
-        // set metatable
+        const void *key = static_cast<const T *>(this);
+        if constexpr (!Lua_IsCached<T>(0)) {
+            // instances created by Lua_New are always cached, a second userdata would not keep them alive
+            lua_rawgetp(L, LUA_REGISTRYINDEX, Lua_CacheKey());
+            if (!lua_isnil(L, -1)) {
+                lua_rawgetp(L, -1, key);
+                if (!lua_isnil(L, -1)) {
+                    lua_remove(L, -2); // cache
+                    return;
+                }
+                lua_pop(L, 1);
+            }
+            lua_pop(L, 1);
+            Lua_PushNew(L);
+        } else {
+            // reuse existing userdata for this instance, so repeated pushes don't allocate
+            Lua_PushCache(L);
+            lua_rawgetp(L, -1, key);
+            if (lua_isnil(L, -1)) {
+                lua_pop(L, 1);
+                Lua_PushNew(L);
+                lua_pushvalue(L, -1);
+                lua_rawsetp(L, -3, key);
+            }
+            lua_remove(L, -2); // cache
+        }
+    }
+
+    // constructs a new instance inside a userdata and pushes it to the Lua stack
+    // the instance is owned by Lua and will be destroyed by __gc
+    template <class... Args>
+    static T* Lua_New(lua_State *L, Args&&... args)
+    {
+        // header, then T at the next suitable alignment
+        constexpr size_t padding = alignof(T) > alignof(Lua_Userdata) ? alignof(T) - 1 : 0;
+        constexpr size_t size = sizeof(Lua_Userdata) + padding + sizeof(T);
+        auto ud = static_cast<Lua_Userdata *>(lua_newuserdata(L, size));
+        ud->object = nullptr;
+        ud->tag = nullptr;
+        void *storage = ud + 1;
+        size_t space = size - sizeof(Lua_Userdata);
+        std::align(alignof(T), sizeof(T), storage, space);
+        // no metatable yet, so nothing is destroyed if the constructor throws
+        T *o = new (storage) T(std::forward<Args>(args)...);
+        ud->object = o;
+        ud->tag = Lua_TypeTag();
         luaL_setmetatable(L, T::Lua_Name);
+        // make Lua_Push return this userdata, also if T::Lua_CacheInstances is false, the entry goes away with it
+        Lua_PushCache(L);
+        lua_pushvalue(L, -2);
+        lua_rawsetp(L, -2, static_cast<const void *>(o));
+        lua_pop(L, 1);
 #ifdef DEBUG
-        printf("%s instance pushed\n", T::Lua_Name);
+        printf("%s instance created\n", T::Lua_Name);
 #endif
+        return o;
+    }
+
+    // removes o from the instance cache, call this before o is destroyed if T::Lua_CacheInstances is true,
+    // so a new instance at the same address will not reuse the old userdata
+    static void Lua_Evict(lua_State *L, const T *o)
+    {
+        lua_rawgetp(L, LUA_REGISTRYINDEX, Lua_CacheKey());
+        if (lua_istable(L, -1)) {
+            lua_pushnil(L);
+            lua_rawsetp(L, -2, o);
+        }
+        lua_pop(L, 1);
     }
 };
 
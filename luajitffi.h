@@ -0,0 +1,221 @@
+#ifndef _LUAGLUE_LUAJITFFI_H
+#define _LUAGLUE_LUAJITFFI_H
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "lua_include.h"
+#include "luacompat.h"
+
+// LuaJIT FFI fast path for LuaInterface methods that only take and return scalars
+// Calls of C functions through the Lua API abort LuaJIT traces, calls of FFI function pointers are compiled.
+// LuaGlue::setffimethods<T>(L, {LUA_FFI_METHOD(T, Method), ...}) replaces methods in the method table of T
+// with a Lua wrapper that checks self and calls a C++ trampoline through the FFI:
+//   T::Lua_Register(L, T::IndexMode::MethodTable);
+//   LuaGlue::setffimethods<T>(L, {LUA_FFI_METHOD(T, GetCount), LUA_FFI_METHOD(T, SetCount)});
+// Arguments are converted by FFI rules instead of LuaMethod's checks (numbers are truncated to integers, no
+// default for missing arguments) and int64_t/uint64_t are returned as 64bit cdata instead of numbers.
+// The methods must not throw, they are called without a lua_State and can't raise Lua errors.
+// Outside of LuaJIT, or if the ffi module is not available, setffimethods returns false and the
+// LuaMethod C functions stay in place, so LUA_FFI_METHOD should be listed in Lua_Methods as LUA_METHOD as well.
+
+// LUA_FFI_METHOD: helper to generate the ffi entry for METHOD, argument types are taken from the method
+// (Tracker, GetCount) => {"GetCount", "int (*)(void*, int)", &trampoline, 1}
+#define LUA_FFI_METHOD(CLASS, METHOD) \
+        (LuaGlue::ffi_method<CLASS, decltype(&CLASS::METHOD), &CLASS::METHOD>::Entry(#METHOD))
+
+struct LuaFFIMethod {
+    std::string_view name;
+    std::string ctype; // function pointer type for ffi.cast
+    void *func; // trampoline taking the userdata block of self as first argument
+    int nargs; // without self
+};
+
+namespace LuaGlue {
+
+// C type names of supported argument and return types
+template <typename T>
+struct ffi_type {
+    static constexpr bool supported = false;
+};
+
+#define _LUA_FFI_TYPE(TYPE, NAME) template <> struct ffi_type<TYPE> { \
+        static constexpr bool supported = true; \
+        static const char* name() { return NAME; } \
+    }
+
+_LUA_FFI_TYPE(void, "void");
+_LUA_FFI_TYPE(bool, "bool");
+_LUA_FFI_TYPE(int, "int");
+_LUA_FFI_TYPE(unsigned, "unsigned int");
+_LUA_FFI_TYPE(int64_t, "int64_t");
+_LUA_FFI_TYPE(uint64_t, "uint64_t");
+_LUA_FFI_TYPE(float, "float");
+_LUA_FFI_TYPE(double, "double");
+
+#undef _LUA_FFI_TYPE
+
+template <typename... A>
+constexpr bool ffi_supported()
+{
+    const bool supported[] = {true, ffi_type<A>::supported...};
+    for (bool s: supported)
+        if (!s)
+            return false;
+    return true;
+}
+
+template <class T, typename FT, FT F, typename R, typename... A>
+struct ffi_call {
+    static_assert(ffi_supported<R, A...>(), "LUA_FFI_METHOD only supports bool, int, unsigned, int64_t, "
+            "uint64_t, float, double (and void as return type)");
+
+    // ud is the userdata block of self, which starts with the object pointer (see LuaInterface::Lua_Userdata)
+    static R Call(void *ud, A... args) noexcept
+    {
+        T *o = *static_cast<T* const*>(ud);
+        if (!o) // destroyed by __gc
+            return R();
+        return (o->*F)(args...);
+    }
+
+    static LuaFFIMethod Entry(std::string_view name)
+    {
+        std::string ctype = ffi_type<R>::name();
+        ctype += " (*)(void*";
+        const char* argTypes[] = {"", ffi_type<A>::name()...};
+        for (size_t i = 1; i < sizeof(argTypes) / sizeof(*argTypes); i++) {
+            ctype += ", ";
+            ctype += argTypes[i];
+        }
+        ctype += ")";
+        return {name, std::move(ctype), reinterpret_cast<void*>(&Call), static_cast<int>(sizeof...(A))};
+    }
+};
+
+template <class T, typename FT, FT F>
+struct ffi_method;
+
+template <class T, class C, typename R, typename... A, R (C::*F)(A...)>
+struct ffi_method<T, R (C::*)(A...), F> : ffi_call<T, R (C::*)(A...), F, R, A...> {};
+
+template <class T, class C, typename R, typename... A, R (C::*F)(A...) const>
+struct ffi_method<T, R (C::*)(A...) const, F> : ffi_call<T, R (C::*)(A...) const, F, R, A...> {};
+
+#ifdef LUACOMPAT_LUAJIT
+// pushes the ffi module, or returns false without pushing anything
+inline bool push_ffi(lua_State *L)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, "_LOADED");
+    if (lua_istable(L, -1)) {
+        lua_getfield(L, -1, LUA_FFILIBNAME);
+        lua_remove(L, -2);
+        if (lua_istable(L, -1))
+            return true;
+    }
+    lua_pop(L, 1);
+    // not loaded yet, luaL_openlibs only preloads it
+    lua_getglobal(L, "require");
+    if (!lua_isfunction(L, -1)) {
+        lua_pop(L, 1);
+        return false;
+    }
+    lua_pushstring(L, LUA_FFILIBNAME);
+    if (lua_pcall(L, 1, 1, 0) != LUA_OK || !lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        return false;
+    }
+    return true;
+}
+
+// pushes the table __index of the metatable at mt resolves methods from, see LuaInterface::Lua_Register
+inline bool push_method_table(lua_State *L, int mt)
+{
+    lua_getfield(L, mt, "__index");
+    if (lua_istable(L, -1))
+        return true;
+    // Lua closure that wraps the method table if the class has a custom __index
+    if (lua_isfunction(L, -1) && !lua_iscfunction(L, -1)) {
+        const char *name = lua_getupvalue(L, -1, 1);
+        if (name && strcmp(name, "methods") == 0 && lua_istable(L, -1)) {
+            lua_remove(L, -2);
+            return true;
+        }
+        if (name)
+            lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+    return false;
+}
+#endif
+
+// replaces methods of T, which has to be registered with IndexMode::MethodTable, by FFI calls
+// returns false and leaves the methods untouched if this is not LuaJIT, ffi can't be loaded or T has no method table
+template <class T>
+bool setffimethods(lua_State *L, std::initializer_list<LuaFFIMethod> methods)
+{
+#ifndef LUACOMPAT_LUAJIT
+    (void)L;
+    (void)methods;
+    return false;
+#else
+    const int top = lua_gettop(L);
+    if (!push_ffi(L))
+        return false;
+    const int ffi = lua_gettop(L);
+    luaL_getmetatable(L, T::Lua_GetName());
+    const int mt = lua_gettop(L);
+    if (!lua_istable(L, mt) || !push_method_table(L, mt)) {
+        lua_settop(L, top);
+        return false;
+    }
+    const int table = lua_gettop(L);
+    luaL_checkstack(L, static_cast<int>(methods.size()) + 8, "too many methods");
+    // create all wrappers before replacing anything
+    for (const auto& method: methods) {
+        std::string params;
+        for (int i = 1; i <= method.nargs; i++)
+            params += ", a" + std::to_string(i);
+        const std::string chunk =
+                "local ffi, ptr, ctype, mt, name, tname = ...\n"
+                "local getmetatable, type, error = getmetatable, type, error\n"
+                "local f = ffi.cast(ctype, ptr)\n"
+                "return function(self" + params + ")\n"
+                "    if getmetatable(self) ~= mt then\n"
+                "        error(\"bad argument #1 to '\" .. name .. \"' (\" .. tname .. \" expected, got \" .. "
+                "type(self) .. \")\", 2)\n"
+                "    end\n"
+                "    return f(self" + params + ")\n"
+                "end\n";
+        if (luaL_loadbuffer(L, chunk.data(), chunk.size(), T::Lua_GetName()) != LUA_OK) {
+            lua_settop(L, top);
+            return false;
+        }
+        lua_pushvalue(L, ffi);
+        lua_pushlightuserdata(L, method.func);
+        lua_pushlstring(L, method.ctype.data(), method.ctype.size());
+        lua_pushvalue(L, mt);
+        lua_pushlstring(L, method.name.data(), method.name.size());
+        lua_pushstring(L, T::Lua_GetName());
+        if (lua_pcall(L, 6, 1, 0) != LUA_OK) {
+            lua_settop(L, top);
+            return false;
+        }
+    }
+    int wrapper = table + 1;
+    for (const auto& method: methods) {
+        lua_pushlstring(L, method.name.data(), method.name.size());
+        lua_pushvalue(L, wrapper++);
+        lua_rawset(L, table);
+    }
+    lua_settop(L, top);
+    return true;
+#endif
+}
+
+} // namespace LuaGlue
+
+#endif // _LUAGLUE_LUAJITFFI_H
@@ -0,0 +1,147 @@
+#ifndef _LUAGLUE_LUAMANIFEST_H
+#define _LUAGLUE_LUAMANIFEST_H
+
+#include <exception>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "lua_include.h"
+#include "luacompat.h"
+#include "luaenum.h"
+#include "luapp.h"
+
+#if defined __cpp_exceptions || defined __EXCEPTIONS || defined _CPPUNWIND
+#   define LUAMANIFEST_HAS_EXCEPTIONS
+#endif
+
+// records the setup of a lua_State once, to apply it to any number of states, see LuaStatePool
+//   LuaManifest manifest;
+//   manifest.OpenLibs().Register<Tracker>().Enum("Color", colors).Global("VERSION", "1.0");
+//   lua_State *L = manifest.NewState();
+// steps run in the order they were added. A manifest must not be modified while it is applied,
+// but it can be applied to different states from different threads at the same time.
+class LuaManifest final {
+public:
+    using Step = std::function<void(lua_State *L)>;
+
+    // luaL_openlibs
+    LuaManifest& OpenLibs()
+    {
+        _steps.emplace_back([](lua_State *L) { luaL_openlibs(L); });
+        return *this;
+    }
+
+    // T::Lua_Register(L, args...), like Lua::Register<T>()
+    template <class T, typename... Args>
+    LuaManifest& Register(Args... args)
+    {
+        _steps.emplace_back([args...](lua_State *L) { T::Lua_Register(L, args...); });
+        return *this;
+    }
+
+    // enum table as global, like LuaEnum::Lua_SetGlobal
+    template <typename T>
+    LuaManifest& Enum(std::string name, LuaEnum<T> values)
+    {
+        _steps.emplace_back([name = std::move(name), values = std::move(values)](lua_State *L) {
+            values.Lua_SetGlobal(L, name.c_str());
+        });
+        return *this;
+    }
+
+    // global value pushed through Lua::Push, strings are copied into the manifest
+    template <typename T>
+    LuaManifest& Global(std::string name, T value)
+    {
+        _steps.emplace_back([name = std::move(name), value = std::move(value)](lua_State *L) {
+            Lua(L).Push(value);
+            lua_setglobal(L, name.c_str());
+        });
+        return *this;
+    }
+
+    LuaManifest& Global(std::string name, const char* value)
+    {
+        return Global(std::move(name), std::string(value));
+    }
+
+    // anything else, e.g. running a Lua chunk or opening single libs
+    // step may raise Lua errors or throw, both abort Apply
+    LuaManifest& Call(Step step)
+    {
+        _steps.push_back(std::move(step));
+        return *this;
+    }
+
+    size_t size() const
+    {
+        return _steps.size();
+    }
+
+    bool empty() const
+    {
+        return _steps.empty();
+    }
+
+    // runs all steps in protected mode, returns false and sets error if a step failed
+    // the stack of L is unchanged either way
+    bool Apply(lua_State *L, std::string *error = nullptr) const
+    {
+        const int top = lua_gettop(L);
+        lua_pushcfunction(L, ApplyProtected);
+        lua_pushlightuserdata(L, const_cast<LuaManifest *>(this));
+        const bool ok = lua_pcall(L, 1, 0, 0) == LUA_OK;
+        if (!ok && error) {
+            const char *msg = lua_tostring(L, -1);
+            *error = msg ? msg : "unknown error";
+        }
+        lua_settop(L, top);
+        return ok;
+    }
+
+    // new state with all steps applied, nullptr if the state could not be created or a step failed
+    lua_State* NewState(std::string *error = nullptr) const
+    {
+        lua_State *L = luaL_newstate();
+        if (!L) {
+            if (error)
+                *error = "not enough memory";
+            return nullptr;
+        }
+        if (!Apply(L, error)) {
+            lua_close(L);
+            return nullptr;
+        }
+        return L;
+    }
+
+private:
+    static int ApplyProtected(lua_State *L)
+    {
+        const auto self = static_cast<const LuaManifest *>(lua_touserdata(L, 1));
+        lua_settop(L, 0);
+        for (const auto& step: self->_steps) {
+#ifdef LUAMANIFEST_HAS_EXCEPTIONS
+            bool failed = false;
+            try {
+                step(L);
+            } catch (const std::exception& e) {
+                lua_pushstring(L, e.what());
+                failed = true;
+            }
+            // the exception is destroyed at this point, so the longjmp does not skip it
+            if (failed)
+                return lua_error(L);
+#else
+            step(L);
+#endif
+            lua_settop(L, 0);
+        }
+        return 0;
+    }
+
+    std::vector<Step> _steps;
+};
+
+#endif // _LUAGLUE_LUAMANIFEST_H
@@ -1,6 +1,7 @@
 #ifndef _LUAGLUE_LUAMETHOD_H
 #define _LUAGLUE_LUAMETHOD_H
 
+// C++14 and C++17 are supported, std::string_view overloads here and in the included headers need C++17
 #if __cplusplus < 201700L && !defined LUA_METHOD_LONG_FORM
 #define LUA_METHOD_LONG_FORM
 #endif
@@ -10,5 +11,44 @@
 #else
 #include "_luamethod.17.h" // c++17 implementation uses auto template argument
 #endif
+#include "_luaoverloads.h" // LUA_OVERLOADS for both implementations
+
+#include <initializer_list>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#include <utility>
+
+namespace LuaGlue {
+
+#if __cplusplus >= 201703L
+using FunctionList = std::initializer_list<std::pair<std::string_view, lua_CFunction>>;
+#else
+using FunctionList = std::initializer_list<std::pair<const char*, lua_CFunction>>;
+#endif
+
+// sets functions, e.g. from LUA_FUNCTION and LUA_STATIC_METHOD, in the table at the top of the stack
+static void setfuncs(lua_State *L, FunctionList funcs)
+{
+    luaL_checkstack(L, 2, "too many functions");
+    for (const auto& func: funcs) {
+#if __cplusplus >= 201703L
+        lua_pushlstring(L, func.first.data(), func.first.size());
+#else
+        lua_pushstring(L, func.first);
+#endif
+        lua_pushcfunction(L, func.second);
+        lua_rawset(L, -3);
+    }
+}
+
+// pushes a new module table with funcs, like luaL_newlib
+static void newlib(lua_State *L, FunctionList funcs)
+{
+    lua_createtable(L, 0, static_cast<int>(funcs.size()));
+    setfuncs(L, funcs);
+}
+
+} // namespace LuaGlue
 
 #endif
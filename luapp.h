@@ -7,6 +7,10 @@
 #include <limits>
 #include <stdint.h>
 #include <stdexcept>
+#include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 
 // Note: we basically wrap lua just to have parameter overloading
@@ -44,8 +48,14 @@ public:
     }
     void Push(const std::string& s)
     {
-        lua_pushstring(L, s.c_str());
+        lua_pushlstring(L, s.data(), s.size());
+    }
+#if __cplusplus >= 201703L
+    void Push(std::string_view s)
+    {
+        lua_pushlstring(L, s.data(), s.size());
     }
+#endif
     void Push(lua_Number n)
     {
         lua_pushnumber(L, n);
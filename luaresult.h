@@ -0,0 +1,127 @@
+#ifndef _LUAGLUE_LUARESULT_H
+#define _LUAGLUE_LUARESULT_H
+
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// error returned from a bound method through LuaResult, raised as Lua error by LuaMethod
+struct LuaError {
+    std::string message;
+
+    explicit LuaError(std::string message) : message(std::move(message)) {}
+};
+
+// value or LuaError, use as return type of a bound method to fail without exceptions:
+//   LuaResult<int> Find(const char* name) { if (...) return LuaError("not found"); return index; }
+// LuaMethod pushes the value (like a plain return value) or raises the error once all C++ arguments are destroyed
+template <typename T>
+class LuaResult final {
+public:
+    LuaResult(LuaError error) : _ok(false)
+    {
+        new (&_error) LuaError(std::move(error));
+    }
+
+    template <typename U = T, typename std::enable_if<std::is_constructible<T, U&&>::value
+            && !std::is_same<typename std::decay<U>::type, LuaError>::value
+            && !std::is_same<typename std::decay<U>::type, LuaResult>::value, int>::type = 0>
+    LuaResult(U&& value) : _ok(true)
+    {
+        new (&_value) T(std::forward<U>(value));
+    }
+
+    LuaResult(const LuaResult& other) : _ok(other._ok)
+    {
+        if (_ok)
+            new (&_value) T(other._value);
+        else
+            new (&_error) LuaError(other._error);
+    }
+
+    LuaResult(LuaResult&& other) : _ok(other._ok)
+    {
+        if (_ok)
+            new (&_value) T(std::move(other._value));
+        else
+            new (&_error) LuaError(std::move(other._error));
+    }
+
+    LuaResult& operator=(const LuaResult& other)
+    {
+        if (this != &other) {
+            clear();
+            new (this) LuaResult(other);
+        }
+        return *this;
+    }
+
+    LuaResult& operator=(LuaResult&& other)
+    {
+        if (this != &other) {
+            clear();
+            new (this) LuaResult(std::move(other));
+        }
+        return *this;
+    }
+
+    ~LuaResult()
+    {
+        clear();
+    }
+
+    bool ok() const { return _ok; }
+    explicit operator bool() const { return ok(); }
+
+    // only valid if ok()
+    const T& value() const { return _value; }
+    T& value() { return _value; }
+
+    // only valid if !ok()
+    const std::string& error() const { return _error.message; }
+
+private:
+    // tagged by _ok, std::variant is C++17
+    union {
+        T _value;
+        LuaError _error;
+    };
+    bool _ok;
+
+    void clear()
+    {
+        if (_ok)
+            _value.~T();
+        else
+            _error.~LuaError();
+    }
+};
+
+template <>
+class LuaResult<void> final {
+public:
+    LuaResult() {}
+    LuaResult(LuaError error) : _error(std::move(error.message)), _ok(false) {}
+
+    bool ok() const { return _ok; }
+    explicit operator bool() const { return ok(); }
+
+    const std::string& error() const { return _error; }
+
+private:
+    std::string _error;
+    bool _ok = true;
+};
+
+namespace LuaGlue {
+
+template <typename T>
+struct is_result : std::false_type {};
+
+template <typename T>
+struct is_result<LuaResult<T>> : std::true_type {};
+
+} // namespace LuaGlue
+
+#endif // _LUAGLUE_LUARESULT_H
@@ -0,0 +1,217 @@
+#ifndef _LUAGLUE_LUASTATEPOOL_H
+#define _LUAGLUE_LUASTATEPOOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "lua_include.h"
+#include "luacompat.h"
+#include "luamanifest.h"
+
+// fixed number of lua_States, created in parallel from a LuaManifest, for worker threads
+//   LuaStatePool pool(manifest, 8);
+//   // on a worker thread
+//   auto L = pool.Checkout(); // blocks until a state is available
+//   luaL_dostring(L, script);
+//   // returned to the pool when L goes out of scope
+// A state is only used by one thread at a time. Globals set by a script stay in the state when it is returned,
+// call Discard() on the handle to replace the state by a fresh one instead.
+class LuaStatePool final {
+public:
+    // checked out state, returns it to the pool when destroyed
+    class Handle final {
+    public:
+        Handle() = default;
+
+        Handle(Handle&& other) noexcept
+            : _pool(other._pool), _L(other._L), _discard(other._discard)
+        {
+            other._pool = nullptr;
+            other._L = nullptr;
+        }
+
+        Handle& operator=(Handle&& other) noexcept
+        {
+            if (this != &other) {
+                Return();
+                _pool = other._pool;
+                _L = other._L;
+                _discard = other._discard;
+                other._pool = nullptr;
+                other._L = nullptr;
+            }
+            return *this;
+        }
+
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+
+        ~Handle()
+        {
+            Return();
+        }
+
+        lua_State* get() const { return _L; }
+        operator lua_State*() const { return _L; }
+        explicit operator bool() const { return _L != nullptr; }
+
+        // close the state on return and create a new one from the manifest
+        void Discard() { _discard = true; }
+
+        // return the state early, the handle is empty afterwards
+        void Return()
+        {
+            if (_pool && _L)
+                _pool->Return(_L, _discard);
+            _pool = nullptr;
+            _L = nullptr;
+            _discard = false;
+        }
+
+    private:
+        friend class LuaStatePool;
+
+        Handle(LuaStatePool *pool, lua_State *L) : _pool(pool), _L(L) {}
+
+        LuaStatePool *_pool = nullptr;
+        lua_State *_L = nullptr;
+        bool _discard = false;
+    };
+
+    // creates size states with up to threads threads, 0 = std::thread::hardware_concurrency()
+    // states that fail to apply the manifest are left out, see size() and error()
+    LuaStatePool(LuaManifest manifest, size_t size, size_t threads = 0)
+        : _manifest(std::move(manifest))
+    {
+        if (threads == 0)
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        threads = std::min(threads, size);
+        std::vector<lua_State *> states(size, nullptr);
+        std::vector<std::string> errors(threads);
+        auto create = [&](size_t worker) {
+            // every worker creates every threads-th state, so no locking is needed
+            for (size_t i = worker; i < size; i += threads)
+                states[i] = _manifest.NewState(&errors[worker]);
+        };
+        std::vector<std::thread> workers;
+        workers.reserve(threads > 0 ? threads - 1 : 0);
+        for (size_t worker = 1; worker < threads; worker++)
+            workers.emplace_back(create, worker);
+        if (threads > 0)
+            create(0);
+        for (auto& worker: workers)
+            worker.join();
+
+        for (lua_State *L: states)
+            if (L)
+                _available.push_back(L);
+        _size = _available.size();
+        for (auto& error: errors) {
+            if (!error.empty()) {
+                _error = std::move(error);
+                break;
+            }
+        }
+    }
+
+    LuaStatePool(const LuaStatePool&) = delete;
+    LuaStatePool& operator=(const LuaStatePool&) = delete;
+
+    // all handles have to be returned before the pool is destroyed
+    ~LuaStatePool()
+    {
+        for (lua_State *L: _available)
+            lua_close(L);
+    }
+
+    // blocks until a state is available, returns an empty handle if the pool has no states
+    Handle Checkout()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this] { return !_available.empty() || _size == 0; });
+        if (_available.empty())
+            return {};
+        return Take();
+    }
+
+    // returns an empty handle if no state is available
+    Handle TryCheckout()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_available.empty())
+            return {};
+        return Take();
+    }
+
+    // number of states owned by the pool, checked out or not
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _size;
+    }
+
+    size_t available() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _available.size();
+    }
+
+    // first error of creating a state, empty if all states were created
+    std::string error() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _error;
+    }
+
+    const LuaManifest& manifest() const
+    {
+        return _manifest;
+    }
+
+private:
+    Handle Take()
+    {
+        // LIFO, so recently used (cache-warm) states are reused first
+        lua_State *L = _available.back();
+        _available.pop_back();
+        return {this, L};
+    }
+
+    void Return(lua_State *L, bool discard)
+    {
+        if (discard) {
+            // replace outside of the lock, creating a state can take a while
+            lua_close(L);
+            std::string error;
+            L = _manifest.NewState(&error);
+            if (!L) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _size--;
+                _error = std::move(error);
+                _cv.notify_all(); // waiters have to re-check an empty pool
+                return;
+            }
+        } else {
+            lua_settop(L, 0);
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _available.push_back(L);
+        }
+        _cv.notify_one();
+    }
+
+    const LuaManifest _manifest;
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    std::vector<lua_State *> _available;
+    size_t _size = 0;
+    std::string _error;
+};
+
+#endif // _LUAGLUE_LUASTATEPOOL_H
@@ -0,0 +1,214 @@
+#ifndef _LUAGLUE_LUAVARARGS_H
+#define _LUAGLUE_LUAVARARGS_H
+
+#include "lua_include.h"
+#include "luacompat.h"
+#include "luavariant.h"
+#include "luaresult.h"
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#include <vector>
+
+// view of the remaining arguments of a LuaMethod call, (L, first, count) on the stack
+// only valid during the call. nothing is copied unless asked for, see toVariant() and toVariants()
+// use as last argument: LUA_METHOD(Tracker, AddItems, const char*, LuaVarArgs) for AddItems(name, ...)
+// Arg::to* raise a Lua error (longjmp) for wrong types, which skips the destructors of everything on the C++
+// stack. Only call them while no local with a non-trivial destructor (std::string, containers, ...) is alive
+// in the method, otherwise use the Arg::try* accessors and return the error through LuaResult.
+class LuaVarArgs final {
+public:
+    // single argument at a stack index
+    class Arg final {
+    public:
+        Arg(lua_State *L, int idx) : _L(L), _idx(idx) {}
+
+        int index() const { return _idx; }
+        int type() const { return lua_type(_L, _idx); }
+        const char* typeName() const { return luaL_typename(_L, _idx); }
+        bool isNil() const { return lua_isnil(_L, _idx); }
+        bool isInteger() const { return lua_isinteger(_L, _idx); }
+        bool isNumber() const { return lua_type(_L, _idx) == LUA_TNUMBER; }
+        bool isString() const { return lua_type(_L, _idx) == LUA_TSTRING; }
+
+        // checked like method arguments, raise a Lua error for wrong types, see the note on LuaVarArgs
+        lua_Integer toInteger() const { return luaL_checkinteger(_L, _idx); }
+        lua_Number toNumber() const { return luaL_checknumber(_L, _idx); }
+        const char* toCString() const { return luaL_checkstring(_L, _idx); }
+#if __cplusplus >= 201703L
+        std::string_view toStringView() const
+        {
+            // points into the Lua string, which is kept alive by the stack during the call
+            size_t len;
+            const char* s = luaL_checklstring(_L, _idx, &len);
+            return {s, len};
+        }
+#endif
+
+        // same checks, but the error is returned instead of raised, so they can be used while C++ objects are
+        // alive. Return the error from a method returning LuaResult to raise it once they are destroyed:
+        //   auto s = arg.tryStringView(); if (!s) return LuaError(s.error());
+        LuaResult<lua_Integer> tryInteger() const
+        {
+            int isnum;
+            const lua_Integer v = lua_tointegerx(_L, _idx, &isnum);
+            if (isnum)
+                return v;
+            if (lua_isnumber(_L, _idx))
+                return argError("number has no integer representation");
+            return typeError("number");
+        }
+        LuaResult<lua_Number> tryNumber() const
+        {
+            int isnum;
+            const lua_Number v = lua_tonumberx(_L, _idx, &isnum);
+            if (isnum)
+                return v;
+            return typeError("number");
+        }
+        LuaResult<const char*> tryCString() const
+        {
+            const char* s = lua_tostring(_L, _idx);
+            if (s)
+                return s;
+            return typeError("string");
+        }
+#if __cplusplus >= 201703L
+        LuaResult<std::string_view> tryStringView() const
+        {
+            size_t len;
+            const char* s = lua_tolstring(_L, _idx, &len);
+            if (s)
+                return std::string_view(s, len);
+            return typeError("string");
+        }
+#endif
+
+        // Lua truthiness
+        bool toBoolean() const { return lua_toboolean(_L, _idx) != 0; }
+
+        // long strings are borrowed from the stack when borrow is true, see LuaVariant::Lua_Borrow
+        LuaVariant toVariant(bool borrow = false) const
+        {
+            LuaVariant v;
+            if (borrow)
+                v.Lua_Borrow(_L, _idx);
+            else
+                v.Lua_Get(_L, _idx);
+            return v;
+        }
+
+    private:
+        lua_State *_L;
+        int _idx;
+
+        // same message as luaL_argerror, without the position, which is added when the error is raised
+        LuaError argError(const char *extramsg) const
+        {
+            int arg = _idx;
+            lua_Debug ar;
+            if (!lua_getstack(_L, 0, &ar))
+                return LuaError("bad argument #" + std::to_string(arg) + " (" + extramsg + ")");
+            lua_getinfo(_L, "n", &ar);
+            if (ar.namewhat && strcmp(ar.namewhat, "method") == 0)
+                arg--; // do not count self
+            return LuaError("bad argument #" + std::to_string(arg) + " to '" + (ar.name ? ar.name : "?")
+                    + "' (" + extramsg + ")");
+        }
+
+        LuaError typeError(const char *tname) const
+        {
+            return argError((std::string(tname) + " expected, got " + luaL_typename(_L, _idx)).c_str());
+        }
+    };
+
+    class iterator final {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = Arg;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Arg;
+
+        iterator(lua_State *L, int idx) : _L(L), _idx(idx) {}
+
+        Arg operator*() const { return {_L, _idx}; }
+        Arg operator[](difference_type n) const { return {_L, _idx + (int)n}; }
+        iterator& operator++() { _idx++; return *this; }
+        iterator operator++(int) { iterator res = *this; _idx++; return res; }
+        iterator& operator--() { _idx--; return *this; }
+        iterator operator--(int) { iterator res = *this; _idx--; return res; }
+        iterator& operator+=(difference_type n) { _idx += (int)n; return *this; }
+        iterator& operator-=(difference_type n) { _idx -= (int)n; return *this; }
+        iterator operator+(difference_type n) const { return {_L, _idx + (int)n}; }
+        iterator operator-(difference_type n) const { return {_L, _idx - (int)n}; }
+        friend iterator operator+(difference_type n, const iterator& it) { return it + n; }
+        difference_type operator-(const iterator& other) const { return _idx - other._idx; }
+        bool operator==(const iterator& other) const { return _idx == other._idx; }
+        bool operator!=(const iterator& other) const { return _idx != other._idx; }
+        bool operator<(const iterator& other) const { return _idx < other._idx; }
+        bool operator>(const iterator& other) const { return _idx > other._idx; }
+        bool operator<=(const iterator& other) const { return _idx <= other._idx; }
+        bool operator>=(const iterator& other) const { return _idx >= other._idx; }
+
+    private:
+        lua_State *_L;
+        int _idx;
+    };
+
+    LuaVarArgs(lua_State *L, int first, int count)
+        : _L(L), _first(lua_absindex(L, first)), _count(count < 0 ? 0 : count)
+    {
+    }
+
+    // arguments from stack index first to the top of the stack
+    static LuaVarArgs FromStack(lua_State *L, int first)
+    {
+        first = lua_absindex(L, first);
+        return {L, first, lua_gettop(L) - first + 1};
+    }
+
+    lua_State* state() const { return _L; }
+    int first() const { return _first; }
+    size_t size() const { return (size_t)_count; }
+    bool empty() const { return _count == 0; }
+
+    // unchecked, i has to be < size()
+    Arg operator[](size_t i) const { return {_L, _first + (int)i}; }
+
+    iterator begin() const { return {_L, _first}; }
+    iterator end() const { return {_L, _first + _count}; }
+
+    // copies all arguments, see Arg::toVariant
+    std::vector<LuaVariant> toVariants(bool borrow = false) const
+    {
+        std::vector<LuaVariant> res;
+        res.reserve(size());
+        for (const auto arg : *this)
+            res.push_back(arg.toVariant(borrow));
+        return res;
+    }
+
+    // pushes all arguments again, e.g. to forward them to a Lua function
+    void Lua_Push(lua_State *L) const
+    {
+        luaL_checkstack(_L, _count, "too many arguments");
+        for (int i = 0; i < _count; i++)
+            lua_pushvalue(_L, _first + i);
+        if (L != _L) {
+            luaL_checkstack(L, _count, "too many arguments");
+            lua_xmove(_L, L, _count);
+        }
+    }
+
+private:
+    lua_State *_L;
+    int _first;
+    int _count;
+};
+
+#endif // _LUAGLUE_LUAVARARGS_H
@@ -4,30 +4,135 @@
 #include "lua_include.h"
 #include "luatype.h"
 #include "luacompat.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
+// compact tagged value: strings up to InlineSize bytes are stored inline, longer strings are owned on the heap
+// or borrowed from Lua (see Lua_Borrow), so fetching a variant does not allocate in most cases
+// tables, functions, userdata and threads are kept as registry reference and pushed back as the same object,
+// so the variant must not outlive the lua_State. It may outlive the coroutine it was fetched from
 class LuaVariant final : public LuaType {
 private:
     #define LUA_TINTEGER 0x100 // this does not actually exist in lua
-    int type = LUA_TNONE;
+    enum Storage : uint8_t {
+        Inline,
+        Heap,
+        Borrowed,
+    };
+
+    struct StringRef {
+        const char* data;
+        size_t len;
+    };
+
+    struct ObjectRef {
+        lua_State* L; // refThread, used to copy, compare and unref
+        int ref; // luaL_ref in LUA_REGISTRYINDEX
+    };
+
+public:
+    static constexpr size_t InlineSize = sizeof(StringRef);
+
+private:
     union {
         lua_Number number;
         int boolean;
         lua_Integer integer;
+        StringRef ref; // Heap or Borrowed
+        ObjectRef object; // isObject()
+        void* pointer; // LUA_TLIGHTUSERDATA
+        char small[InlineSize]; // Inline, not NUL terminated
     };
-    std::string string;
-    
-public:
-    bool operator==(const LuaVariant& other) const {
-        if (type != other.type) return false;
-        if (type == LUA_TNIL || type == LUA_TNONE) return true;
-        if (type == LUA_TINTEGER) return integer==other.integer;
-        if (type == LUA_TNUMBER) return number==other.number;
-        if (type == LUA_TBOOLEAN) return boolean==other.boolean;
-        if (type == LUA_TSTRING) return string==other.string;
-        return false;
+    int type = LUA_TNONE;
+    Storage storage = Inline;
+    uint8_t smallLen = 0;
+
+    void setString(const char* s, const size_t len, const bool borrow)
+    {
+        type = LUA_TSTRING;
+        if (len <= InlineSize) {
+            storage = Inline;
+            smallLen = static_cast<uint8_t>(len);
+            if (len)
+                memcpy(small, s, len);
+        } else if (borrow) {
+            storage = Borrowed;
+            ref = {s, len};
+        } else {
+            storage = Heap;
+            char* data = new char[len];
+            memcpy(data, s, len);
+            ref = {data, len};
+        }
     }
-    bool Lua_Get(lua_State *L, int i) {
+
+    // string value, empty for other types
+    StringRef chars() const
+    {
+        if (type != LUA_TSTRING)
+            return {"", 0};
+        if (storage == Inline)
+            return {small, smallLen};
+        return ref;
+    }
+
+    bool isObject() const
+    {
+        return type == LUA_TTABLE || type == LUA_TFUNCTION || type == LUA_TUSERDATA || type == LUA_TTHREAD;
+    }
+
+    // thread of the lua_State that is only used for the references, anchored in the registry
+    // it never runs, so its stack is free whichever thread copies or destroys the variant, unlike the main thread,
+    // which may be inside lua_resume, or the calling coroutine, which may be collected before the variant
+    static lua_State* refThread(lua_State *L)
+    {
+        static const char key = 0;
+        lua_rawgetp(L, LUA_REGISTRYINDEX, &key);
+        lua_State* thread = lua_tothread(L, -1);
+        lua_pop(L, 1);
+        if (!thread) {
+            thread = lua_newthread(L);
+            lua_rawsetp(L, LUA_REGISTRYINDEX, &key);
+        }
+        return thread;
+    }
+
+    void clear()
+    {
+        if (type == LUA_TSTRING && storage == Heap)
+            delete[] ref.data;
+        else if (isObject())
+            luaL_unref(object.L, LUA_REGISTRYINDEX, object.ref);
+        type = LUA_TNONE;
+        storage = Inline;
+    }
+
+    void copyFrom(const LuaVariant& other)
+    {
+        if (other.type == LUA_TSTRING && other.storage == Heap) {
+            setString(other.ref.data, other.ref.len, false);
+            return;
+        }
+        if (other.isObject()) {
+            // new reference to the same object
+            lua_rawgeti(other.object.L, LUA_REGISTRYINDEX, other.object.ref);
+            object = {other.object.L, luaL_ref(other.object.L, LUA_REGISTRYINDEX)};
+            type = other.type;
+            return;
+        }
+        memcpy(static_cast<void*>(small), other.small, InlineSize); // copies any of the union members
+        type = other.type;
+        storage = other.storage;
+        smallLen = other.smallLen;
+    }
+
+    bool get(lua_State *L, int i, bool borrow) {
+        clear();
         type = lua_type(L, i);
         switch (type) {
             case LUA_TNUMBER:
@@ -39,21 +144,135 @@ public:
                 }
                 break;
             case LUA_TSTRING:
-                string = lua_tostring(L, i);
+            {
+                size_t len;
+                const char* s = lua_tolstring(L, i, &len);
+                setString(s, len, borrow);
                 break;
+            }
             case LUA_TBOOLEAN:
                 boolean = lua_toboolean(L, i);
                 break;
+            case LUA_TLIGHTUSERDATA:
+                pointer = lua_touserdata(L, i);
+                break;
+            case LUA_TTABLE:
+            case LUA_TFUNCTION:
+            case LUA_TUSERDATA:
+            case LUA_TTHREAD:
+                lua_pushvalue(L, i);
+                object = {refThread(L), luaL_ref(L, LUA_REGISTRYINDEX)};
+                break;
             case LUA_TNIL:
                 break;
             case LUA_TNONE:
                 return false;
             default:
-                // TODO: user type
+                type = LUA_TNONE;
                 return false;
         }
         return true;
     }
+
+public:
+    LuaVariant() {}
+
+    LuaVariant(const LuaVariant& other)
+        : LuaType()
+    {
+        copyFrom(other);
+    }
+
+    LuaVariant(LuaVariant&& other) noexcept
+        : LuaType()
+    {
+        memcpy(static_cast<void*>(small), other.small, InlineSize);
+        type = other.type;
+        storage = other.storage;
+        smallLen = other.smallLen;
+        other.type = LUA_TNONE; // heap data or reference now belongs to this
+        other.storage = Inline;
+    }
+
+    ~LuaVariant()
+    {
+        clear();
+    }
+
+    LuaVariant& operator=(const LuaVariant& other)
+    {
+        if (this != &other) {
+            clear();
+            copyFrom(other);
+        }
+        return *this;
+    }
+
+    LuaVariant& operator=(LuaVariant&& other) noexcept
+    {
+        if (this != &other) {
+            clear();
+            memcpy(static_cast<void*>(small), other.small, InlineSize);
+            type = other.type;
+            storage = other.storage;
+            smallLen = other.smallLen;
+            other.type = LUA_TNONE;
+            other.storage = Inline;
+        }
+        return *this;
+    }
+
+    bool operator==(const LuaVariant& other) const {
+        if (type != other.type) return false;
+        if (type == LUA_TNIL || type == LUA_TNONE) return true;
+        if (type == LUA_TINTEGER) return integer==other.integer;
+        if (type == LUA_TNUMBER) return number==other.number;
+        if (type == LUA_TBOOLEAN) return boolean==other.boolean;
+        if (type == LUA_TSTRING) {
+            const StringRef s = chars(), o = other.chars();
+            return s.len == o.len && (s.len == 0 || memcmp(s.data, o.data, s.len) == 0);
+        }
+        if (type == LUA_TLIGHTUSERDATA) return pointer==other.pointer;
+        if (isObject()) {
+            if (object.ref == other.object.ref) return object.L==other.object.L;
+            lua_rawgeti(object.L, LUA_REGISTRYINDEX, object.ref);
+            lua_rawgeti(object.L, LUA_REGISTRYINDEX, other.object.ref);
+            const bool res = lua_rawequal(object.L, -1, -2) != 0;
+            lua_pop(object.L, 2);
+            return res;
+        }
+        return false;
+    }
+
+    // reads the value at stack index i, strings are copied, tables, functions, userdata and threads are referenced
+    bool Lua_Get(lua_State *L, int i) {
+        return get(L, i, false);
+    }
+
+    // same as Lua_Get, but long strings point into the Lua string instead of being copied
+    // only valid while the Lua value is anchored (on the stack or by a ref), use own() to detach
+    bool Lua_Borrow(lua_State *L, int i) {
+        return get(L, i, true);
+    }
+
+    // copies a borrowed string so the variant no longer depends on the Lua value
+    void own() {
+        if (type == LUA_TSTRING && storage == Borrowed)
+            setString(ref.data, ref.len, false);
+    }
+
+    bool isBorrowed() const {
+        return type == LUA_TSTRING && storage == Borrowed;
+    }
+
+#if __cplusplus >= 201703L
+    // string value, empty for other types
+    std::string_view stringView() const {
+        const StringRef s = chars();
+        return {s.data, s.len};
+    }
+#endif
+
     void Lua_Push(lua_State *L) const {
         switch (type) {
             case LUA_TINTEGER:
@@ -66,7 +285,13 @@ public:
                 lua_pushboolean(L, boolean);
                 break;
             case LUA_TSTRING:
-                lua_pushstring(L, string.c_str());
+            {
+                const StringRef s = chars();
+                lua_pushlstring(L, s.data, s.len);
+                break;
+            }
+            case LUA_TLIGHTUSERDATA:
+                lua_pushlightuserdata(L, pointer);
                 break;
             case LUA_TNIL:
                 lua_pushnil(L);
@@ -74,7 +299,8 @@ public:
             case LUA_TNONE:
                 break;
             default:
-                // TODO: user type
+                // the original object
+                lua_rawgeti(L, LUA_REGISTRYINDEX, object.ref);
                 break;
         }
     }
@@ -87,14 +313,34 @@ public:
             case LUA_TBOOLEAN:
                 return boolean ? "true" : "false";
             case LUA_TSTRING:
-                return "\""+string+"\"";
+            {
+                const StringRef s = chars();
+                std::string res;
+                res.reserve(s.len + 2);
+                res += '"';
+                res.append(s.data, s.len);
+                res += '"';
+                return res;
+            }
             case LUA_TNIL:
                 return "nil";
             case LUA_TNONE:
                 return "";
+            case LUA_TLIGHTUSERDATA:
+            {
+                char buf[64];
+                snprintf(buf, sizeof(buf), "userdata: %p", pointer);
+                return buf;
+            }
             default:
-                // TODO: user type
-                return "<not implemented>";
+            {
+                // same as tostring() without __tostring
+                char buf[64];
+                lua_rawgeti(object.L, LUA_REGISTRYINDEX, object.ref);
+                snprintf(buf, sizeof(buf), "%s: %p", lua_typename(object.L, type), lua_topointer(object.L, -1));
+                lua_pop(object.L, 1);
+                return buf;
+            }
         }
     }
 
@@ -109,4 +355,3 @@ public:
 
 
 #endif /* _LUAGLUE_LUAVARIANT_H */
-
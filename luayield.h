@@ -0,0 +1,30 @@
+#ifndef _LUAGLUE_LUAYIELD_H
+#define _LUAGLUE_LUAYIELD_H
+
+#include <type_traits>
+#include "lua_include.h"
+
+// return value of a bound method to yield the calling coroutine instead of returning
+//   LuaYield Wait(lua_State *L, int ms) { _waiting.push_back({L, ms}); return LuaYield(); }
+//   LUA_METHOD(Timer, Wait, lua_State*, int)
+// the count values the method pushed onto L are passed to the resumer (lua_resume, coroutine.resume).
+// The next resume continues the Lua code after the method call, which returns the values passed to resume.
+// LuaMethod yields once all C++ arguments are destroyed, yielding from the main thread raises a Lua error.
+struct LuaYield {
+    int count;
+
+    explicit LuaYield(int count = 0) : count(count) {}
+};
+
+namespace LuaGlue {
+
+// return types that suspend the calling coroutine until a result is available, see luaasync.h
+// specializations derive from std::true_type and provide
+//   static int start(lua_State *L, T&& value)
+// which returns the number of values to yield (see yield_results) or RaiseError with an error message pushed
+template <typename T>
+struct async_traits : std::false_type {};
+
+} // namespace LuaGlue
+
+#endif // _LUAGLUE_LUAYIELD_H
@@ -0,0 +1,30 @@
+#!/bin/sh
+set -e
+
+if [ -z "$CXX" ]; then
+  CXX="g++"
+fi
+
+LIBS="-lbenchmark_main -lbenchmark -lpthread"
+if [ "$LUA_VERSION" != "" ]; then
+  LIBS="$LIBS $(pkg-config --cflags --libs "$LUA_VERSION")"
+else
+  LIBS="$LIBS -llua"
+fi
+WARN_FLAGS="-Wall -Wextra -Werror -Wno-unused-function"
+OPT_FLAGS="-O2 -DNDEBUG"
+TEST_DIR="$(dirname "$0")"
+BENCH_FILES="$TEST_DIR/bench/*.cpp"
+BENCH_BUILD_DIR="$TEST_DIR/build"
+BENCH_EXE="$BENCH_BUILD_DIR/bench"
+# results are also written as json, to diff runs e.g. with tools/compare.py from google benchmark
+if [ -z "$BENCH_OUT" ]; then
+  BENCH_OUT="$BENCH_BUILD_DIR/bench-${LUA_VERSION:-lua}.json"
+fi
+
+mkdir -p "$BENCH_BUILD_DIR"
+# shellcheck disable=SC2086
+"$CXX" -o "$BENCH_EXE" $BENCH_FILES $LIBS $WARN_FLAGS $OPT_FLAGS
+
+# arguments are passed to google benchmark, e.g. --benchmark_filter=Index
+"$BENCH_EXE" --benchmark_out="$BENCH_OUT" --benchmark_out_format=json "$@"
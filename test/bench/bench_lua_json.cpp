@@ -0,0 +1,346 @@
+#include "luabenchbase.hpp"
+#include "../../lua_json.h"
+
+
+// pushes a table that looks like a typical state dump with n entries
+static void pushStateDump(lua_State* L, const int n)
+{
+    lua_pushinteger(L, n);
+    lua_setglobal(L, "n");
+    const char* script = R""""(
+        local items = {}
+        for i = 1, n do
+            items[i] = {
+                id = i,
+                name = "item " .. i,
+                tags = {"a", "b", "c"},
+                pos = {x = i * 1.5, y = i * 0.25},
+                active = i % 2 == 0,
+            }
+        end
+        return {items = items, count = n, version = "1.0"}
+    )"""";
+    if (luaL_dostring(L, script) != LUA_OK)
+        lua_pushnil(L);
+}
+
+static void BM_LuaToJsonDump(benchmark::State& state)
+{
+    LuaBenchState lua;
+    pushStateDump(lua.L, static_cast<int>(state.range(0)));
+    size_t bytes = 0;
+    for (auto _: state) {
+        std::string s = lua_to_json(lua.L, -1).dump();
+        bytes += s.size();
+        benchmark::DoNotOptimize(s);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+
+static void BM_LuaToJsonString(benchmark::State& state)
+{
+    LuaBenchState lua;
+    pushStateDump(lua.L, static_cast<int>(state.range(0)));
+    size_t bytes = 0;
+    for (auto _: state) {
+        std::string s = lua_to_json_string(lua.L, -1);
+        bytes += s.size();
+        benchmark::DoNotOptimize(s);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+
+BENCHMARK(BM_LuaToJsonDump)->Arg(10)->Arg(10000);
+BENCHMARK(BM_LuaToJsonString)->Arg(10)->Arg(10000);
+
+static std::string stateDumpText(const int n)
+{
+    LuaBenchState lua;
+    pushStateDump(lua.L, n);
+    return lua_to_json_string(lua.L, -1);
+}
+
+static void BM_JsonParseToLua(benchmark::State& state)
+{
+    LuaBenchState lua;
+    const std::string s = stateDumpText(static_cast<int>(state.range(0)));
+    for (auto _: state) {
+        json_to_lua(lua.L, json::parse(s));
+        lua_pop(lua.L, 1);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * s.size()));
+}
+
+static void BM_JsonTextToLua(benchmark::State& state)
+{
+    LuaBenchState lua;
+    const std::string s = stateDumpText(static_cast<int>(state.range(0)));
+    for (auto _: state) {
+        json_text_to_lua(lua.L, s.data(), s.size());
+        lua_pop(lua.L, 1);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * s.size()));
+}
+
+BENCHMARK(BM_JsonParseToLua)->Arg(10)->Arg(10000);
+BENCHMARK(BM_JsonTextToLua)->Arg(10)->Arg(10000);
+
+static void BM_JsonToLuaArray(benchmark::State& state)
+{
+    LuaBenchState lua;
+    json j = json::array();
+    for (int64_t i = 0; i < state.range(0); i++)
+        j.push_back(i);
+    for (auto _: state) {
+        json_to_lua(lua.L, j);
+        lua_pop(lua.L, 1);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_JsonToLuaObject(benchmark::State& state)
+{
+    LuaBenchState lua;
+    json j = json::object();
+    for (int64_t i = 0; i < state.range(0); i++)
+        j["key" + std::to_string(i)] = i;
+    for (auto _: state) {
+        json_to_lua(lua.L, j);
+        lua_pop(lua.L, 1);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_JsonToLuaStateDump(benchmark::State& state)
+{
+    LuaBenchState lua;
+    const json j = json::parse(stateDumpText(static_cast<int>(state.range(0))));
+    for (auto _: state) {
+        json_to_lua(lua.L, j);
+        lua_pop(lua.L, 1);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_JsonToLuaArray)->Arg(10)->Arg(100000);
+BENCHMARK(BM_JsonToLuaObject)->Arg(10)->Arg(100000);
+BENCHMARK(BM_JsonToLuaStateDump)->Arg(10000);
+
+static void BM_LuaToJsonArray(benchmark::State& state)
+{
+    LuaBenchState lua;
+    lua_createtable(lua.L, static_cast<int>(state.range(0)), 0);
+    for (int64_t i = 1; i <= state.range(0); i++) {
+        lua_pushnumber(lua.L, static_cast<lua_Number>(i) * 0.5);
+        lua_rawseti(lua.L, -2, static_cast<int>(i));
+    }
+    for (auto _: state)
+        benchmark::DoNotOptimize(lua_to_json(lua.L, -1));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_LuaToJsonArray)->Arg(10)->Arg(100000);
+
+// n nested tables {v = i, next = {...}}
+static void pushDeep(lua_State* L, const int n)
+{
+    lua_pushinteger(L, n);
+    lua_setglobal(L, "n");
+    const char* script = R""""(
+        local root = {}
+        local t = root
+        for i = 1, n - 1 do
+            t.v = i
+            t.next = {}
+            t = t.next
+        end
+        return root
+    )"""";
+    if (luaL_dostring(L, script) != LUA_OK)
+        lua_pushnil(L);
+}
+
+static void BM_LuaToJsonDeep(benchmark::State& state)
+{
+    LuaBenchState lua;
+    pushDeep(lua.L, static_cast<int>(state.range(0)));
+    for (auto _: state)
+        benchmark::DoNotOptimize(lua_to_json(lua.L, -1));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_LuaToJsonWide(benchmark::State& state)
+{
+    LuaBenchState lua;
+    pushStateDump(lua.L, static_cast<int>(state.range(0)));
+    for (auto _: state)
+        benchmark::DoNotOptimize(lua_to_json(lua.L, -1));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_JsonToLuaDeep(benchmark::State& state)
+{
+    LuaBenchState lua;
+    pushDeep(lua.L, static_cast<int>(state.range(0)));
+    const json j = lua_to_json(lua.L, -1);
+    lua_pop(lua.L, 1);
+    for (auto _: state) {
+        json_to_lua(lua.L, j);
+        lua_pop(lua.L, 1);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_LuaToJsonDeep)->Arg(900);
+BENCHMARK(BM_LuaToJsonWide)->Arg(10000);
+BENCHMARK(BM_JsonToLuaDeep)->Arg(900);
+
+// root with n children that all reference the root and one shared table of n elements
+static void pushShared(lua_State* L, const int n)
+{
+    lua_pushinteger(L, n);
+    lua_setglobal(L, "n");
+    const char* script = R""""(
+        local root = {}
+        local shared = {}
+        for i = 1, n do
+            shared[i] = i
+        end
+        for i = 1, n do
+            root["k" .. i] = {v = i, root = root, shared = shared}
+        end
+        return root
+    )"""";
+    if (luaL_dostring(L, script) != LUA_OK)
+        lua_pushnil(L);
+}
+
+static void BM_LuaToJsonCycleFail(benchmark::State& state)
+{
+    LuaBenchState lua;
+    pushShared(lua.L, static_cast<int>(state.range(0)));
+    for (auto _: state) {
+        try {
+            benchmark::DoNotOptimize(lua_to_json(lua.L, -1));
+        } catch (const std::runtime_error&) {
+        }
+    }
+}
+
+static void BM_LuaToJsonCycles(benchmark::State& state)
+{
+    LuaBenchState lua;
+    pushShared(lua.L, static_cast<int>(state.range(0)));
+    const auto mode = static_cast<LuaJsonCycles>(state.range(1));
+    for (auto _: state)
+        benchmark::DoNotOptimize(lua_to_json(lua.L, -1, 1000, mode));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_LuaToJsonCycleFail)->Arg(1000);
+BENCHMARK(BM_LuaToJsonCycles)
+        ->Args({1000, static_cast<int>(LuaJsonCycles::Null)})
+        ->Args({1000, static_cast<int>(LuaJsonCycles::Reference)});
+
+// pathological documents, scripts return the table to convert
+static const char* const luaJsonLongStrings = R""""(
+    local s = "0123456789abcdef"
+    for _ = 1, 12 do s = s .. s end -- 64KB
+    local t = {}
+    for i = 1, 16 do t[i] = s .. i end
+    return t
+)"""";
+
+static const char* const luaJsonEscapes = R""""(
+    local t = {}
+    for i = 1, 1000 do t[i] = "quote\" backslash\\ newline\n tab\t ctrl\1\31 utf8 \195\164\226\130\172 " .. i end
+    return t
+)"""";
+
+static const char* const luaJsonSparse = R""""(
+    local t = {}
+    for i = 1, 100 do t[i * i] = i end
+    return t
+)"""";
+
+static const char* const luaJsonMixedKeys = R""""(
+    local t = {}
+    for i = 1, 1000 do t[i] = i; t["k" .. i] = i; t[i + 0.5] = i end
+    return t
+)"""";
+
+static const char* const luaJsonNumbers = R""""(
+    local t = {}
+    for i = 1, 10000 do t[i] = i % 2 == 0 and i * 1000003 or i / 7 end
+    return t
+)"""";
+
+static bool pushDocument(benchmark::State& state, lua_State* L, const char* script)
+{
+    if (luaL_dostring(L, script) == LUA_OK)
+        return true;
+    state.SkipWithError(lua_tostring(L, -1));
+    return false;
+}
+
+static void BM_LuaToJsonDocument(benchmark::State& state, const char* script)
+{
+    LuaBenchState lua;
+    if (!pushDocument(state, lua.L, script))
+        return;
+    for (auto _: state)
+        benchmark::DoNotOptimize(lua_to_json(lua.L, -1));
+}
+
+static void BM_LuaToJsonStringDocument(benchmark::State& state, const char* script)
+{
+    LuaBenchState lua;
+    if (!pushDocument(state, lua.L, script))
+        return;
+    size_t bytes = 0;
+    for (auto _: state) {
+        std::string s = lua_to_json_string(lua.L, -1);
+        bytes += s.size();
+        benchmark::DoNotOptimize(s);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+
+static void BM_JsonToLuaDocument(benchmark::State& state, const char* script)
+{
+    LuaBenchState lua;
+    if (!pushDocument(state, lua.L, script))
+        return;
+    const json j = lua_to_json(lua.L, -1);
+    lua_pop(lua.L, 1);
+    for (auto _: state) {
+        json_to_lua(lua.L, j);
+        lua_pop(lua.L, 1);
+    }
+}
+
+static void BM_JsonTextToLuaDocument(benchmark::State& state, const char* script)
+{
+    LuaBenchState lua;
+    if (!pushDocument(state, lua.L, script))
+        return;
+    const std::string s = lua_to_json_string(lua.L, -1);
+    lua_pop(lua.L, 1);
+    for (auto _: state) {
+        json_text_to_lua(lua.L, s.data(), s.size());
+        lua_pop(lua.L, 1);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * s.size()));
+}
+
+#define LUA_JSON_DOCUMENT_BENCHMARKS(NAME, SCRIPT) \
+    BENCHMARK_CAPTURE(BM_LuaToJsonDocument, NAME, SCRIPT); \
+    BENCHMARK_CAPTURE(BM_LuaToJsonStringDocument, NAME, SCRIPT); \
+    BENCHMARK_CAPTURE(BM_JsonToLuaDocument, NAME, SCRIPT); \
+    BENCHMARK_CAPTURE(BM_JsonTextToLuaDocument, NAME, SCRIPT)
+
+LUA_JSON_DOCUMENT_BENCHMARKS(LongStrings, luaJsonLongStrings);
+LUA_JSON_DOCUMENT_BENCHMARKS(Escapes, luaJsonEscapes);
+LUA_JSON_DOCUMENT_BENCHMARKS(Sparse, luaJsonSparse);
+LUA_JSON_DOCUMENT_BENCHMARKS(MixedKeys, luaJsonMixedKeys);
+LUA_JSON_DOCUMENT_BENCHMARKS(Numbers, luaJsonNumbers);
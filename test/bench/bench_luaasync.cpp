@@ -0,0 +1,110 @@
+#include <chrono>
+#include <functional>
+#include <thread>
+#include "luabenchbase.hpp"
+#include "../../luainterface.h"
+#include "../../luamethod.h"
+#include "../../luaasync.h"
+
+
+// ReSharper disable CppMemberFunctionMayBeStatic
+class BenchAsyncObject : public LuaInterface<BenchAsyncObject> {
+    friend class LuaInterface;
+
+public:
+    LuaAsync<int> Add(int a) const
+    {
+        return LuaAsync<int>([a]() { return a + 1; });
+    }
+
+    // simulated I/O, sleeps without using the CPU
+    LuaAsync<int> Sleep(int ms) const
+    {
+        return LuaAsync<int>([ms]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+            return ms;
+        });
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "BenchAsyncObject";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(BenchAsyncObject, Add, int),
+        LUA_METHOD(BenchAsyncObject, Sleep, int),
+    });
+};
+
+static void setupAsync(lua_State *L)
+{
+    luaL_openlibs(L);
+    BenchAsyncObject::Lua_Register(L);
+    BenchAsyncObject::Lua_New(L);
+    lua_setglobal(L, "o");
+}
+
+// start, inline work and resume through Pump, per round trip, without thread hand-off
+static void BM_AsyncInline(benchmark::State& state)
+{
+    LuaBenchState lua;
+    LuaAsyncScheduler scheduler(lua.L, [](std::function<void()> work) { work(); });
+    setupAsync(lua.L);
+    if (luaL_loadstring(lua.L, "local o = o; local f = o.Add; local n = 0; while true do n = f(o, n) end") != LUA_OK
+            || !scheduler.Spawn()) {
+        state.SkipWithError("spawn failed");
+        return;
+    }
+    for (auto _: state) {
+        for (int i = 0; i < LUA_BENCH_LOOP; i++)
+            scheduler.Pump();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * LUA_BENCH_LOOP);
+}
+
+BENCHMARK(BM_AsyncInline);
+
+// same round trip through the thread pool, includes waking up the worker and the interpreter thread
+static void BM_AsyncPool(benchmark::State& state)
+{
+    LuaBenchState lua;
+    LuaAsyncScheduler scheduler(lua.L, 1);
+    setupAsync(lua.L);
+    if (luaL_loadstring(lua.L, "local o = o; local f = o.Add; local n = 0; while true do n = f(o, n) end") != LUA_OK
+            || !scheduler.Spawn()) {
+        state.SkipWithError("spawn failed");
+        return;
+    }
+    for (auto _: state) {
+        for (int i = 0; i < LUA_BENCH_LOOP;)
+            i += scheduler.Pump(std::chrono::milliseconds(100));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * LUA_BENCH_LOOP);
+}
+
+BENCHMARK(BM_AsyncPool);
+
+// 64 coroutines each waiting for 1ms of simulated I/O, with range(0) pool threads
+// the interpreter thread keeps running, so the time shrinks with the number of threads
+static void BM_AsyncLatency(benchmark::State& state)
+{
+    constexpr int coroutines = 64;
+    LuaBenchState lua;
+    LuaAsyncScheduler scheduler(lua.L, static_cast<size_t>(state.range(0)));
+    setupAsync(lua.L);
+    if (luaL_loadstring(lua.L, "local o = o; return function() o:Sleep(1) end") != LUA_OK
+            || lua_pcall(lua.L, 0, 1, 0) != LUA_OK) {
+        state.SkipWithError(lua_tostring(lua.L, -1));
+        return;
+    }
+    for (auto _: state) {
+        for (int i = 0; i < coroutines; i++) {
+            lua_pushvalue(lua.L, -1);
+            scheduler.Spawn();
+        }
+        while (scheduler.pending() > 0)
+            scheduler.Pump(std::chrono::milliseconds(100));
+    }
+    lua_settop(lua.L, 0);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * coroutines);
+}
+
+BENCHMARK(BM_AsyncLatency)->Arg(1)->Arg(8)->Arg(64)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,365 @@
+#include <cstring>
+#include "luabenchbase.hpp"
+#include "../../luainterface.h"
+#include "../../luamethod.h"
+
+
+// ReSharper disable CppMemberFunctionMayBeStatic
+class BenchObject : public LuaInterface<BenchObject> {
+    friend class LuaInterface;
+
+    int Get() const
+    {
+        return 1;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "BenchObject";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(BenchObject, Get, void),
+    });
+};
+
+// same as BenchObject, but with a property, so __index needs a fallback
+class BenchPropertyObject : public LuaInterface<BenchPropertyObject> {
+    friend class LuaInterface;
+
+    int Get() const
+    {
+        return 1;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "BenchPropertyObject";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(BenchPropertyObject, Get, void),
+    });
+
+    int Lua_Index(lua_State *L, const char *key) override
+    {
+        if (strcmp(key, "value") == 0) {
+            lua_pushinteger(L, 1);
+            return 1;
+        }
+        return 0;
+    }
+};
+
+// same as BenchPropertyObject, but with the property in Lua_Properties
+class BenchDeclaredPropertyObject : public LuaInterface<BenchDeclaredPropertyObject> {
+    friend class LuaInterface;
+
+    int value = 1;
+
+    int Get() const
+    {
+        return 1;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "BenchDeclaredPropertyObject";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(BenchDeclaredPropertyObject, Get, void),
+    });
+    static constexpr auto Lua_Properties = MakePropertyMap({
+        LUA_PROPERTY(BenchDeclaredPropertyObject, value),
+    });
+};
+
+static int BenchGet()
+{
+    return 1;
+}
+
+// multiple results as tuple vs. json table
+class BenchResultsObject : public LuaInterface<BenchResultsObject> {
+    friend class LuaInterface;
+
+    std::pair<int, int> GetPosition() const
+    {
+        return {1, 2};
+    }
+
+    json GetPositionJson() const
+    {
+        return {{"x", 1}, {"y", 2}};
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "BenchResultsObject";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(BenchResultsObject, GetPosition, void),
+        LUA_METHOD(BenchResultsObject, GetPositionJson, void),
+    });
+};
+
+// overloaded method vs. plain method
+class BenchOverloadObject : public LuaInterface<BenchOverloadObject> {
+    friend class LuaInterface;
+
+    int Set(int a)
+    {
+        return a;
+    }
+
+    int Set(int a, int b)
+    {
+        return a + b;
+    }
+
+    int Set(const char*, int b)
+    {
+        return b;
+    }
+
+    int SetOne(int a)
+    {
+        return a;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "BenchOverloadObject";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_OVERLOADS(BenchOverloadObject, Set, int(int), int(int, int), int(const char*, int)),
+        LUA_METHOD(BenchOverloadObject, SetOne, int),
+    });
+};
+
+// variable arguments vs. table
+class BenchVarArgsObject : public LuaInterface<BenchVarArgsObject> {
+    friend class LuaInterface;
+
+    size_t total = 0;
+
+    void AddItems(LuaVarArgs items)
+    {
+        for (const auto item : items)
+            total += item.toStringView().size();
+    }
+
+    void AddItemsJson(json items)
+    {
+        for (const auto& item : items)
+            total += item.get_ref<const std::string&>().size();
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "BenchVarArgsObject";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(BenchVarArgsObject, AddItems, LuaVarArgs),
+        LUA_METHOD(BenchVarArgsObject, AddItemsJson, json),
+    });
+};
+
+// plain result vs. LuaResult, both without error
+class BenchErrorObject : public LuaInterface<BenchErrorObject> {
+    friend class LuaInterface;
+
+    int Add(int a, const char* s) const
+    {
+        return a + (int)s[0];
+    }
+
+    LuaResult<int> AddChecked(int a, const char* s) const
+    {
+        if (!s[0])
+            return LuaError("empty string");
+        return a + (int)s[0];
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "BenchErrorObject";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(BenchErrorObject, Add, int, const char*),
+        LUA_METHOD(BenchErrorObject, AddChecked, int, const char*),
+    });
+};
+
+template <class T>
+static void runIndexBench(benchmark::State& state, typename T::IndexMode mode, const char* script)
+{
+    LuaBenchState lua;
+    T o;
+    T::Lua_Register(lua.L, mode);
+    o.Lua_Push(lua.L);
+    lua_setglobal(lua.L, "o");
+    lua.run(state, script);
+}
+
+static void BM_Index(benchmark::State& state, BenchObject::IndexMode mode, const char* script)
+{
+    runIndexBench<BenchObject>(state, mode, script);
+}
+
+static void BM_IndexWithProperties(benchmark::State& state, BenchPropertyObject::IndexMode mode, const char* script)
+{
+    runIndexBench<BenchPropertyObject>(state, mode, script);
+}
+
+static void BM_IndexWithDeclaredProperties(benchmark::State& state, BenchDeclaredPropertyObject::IndexMode mode,
+        const char* script)
+{
+    runIndexBench<BenchDeclaredPropertyObject>(state, mode, script);
+}
+
+#define METHOD_CALL "local o = o; " LUA_BENCH_FOR "o:Get() end"
+#define PROPERTY_READ "local o = o; " LUA_BENCH_FOR "local _ = o.value end"
+#define PROPERTY_WRITE "local o = o; " LUA_BENCH_FOR "o.value = i end"
+#define INDEX_MISS "local o = o; " LUA_BENCH_FOR "local _ = o.missing end"
+
+BENCHMARK_CAPTURE(BM_Index, MethodCall_Function,
+        BenchObject::IndexMode::Function, METHOD_CALL);
+BENCHMARK_CAPTURE(BM_Index, MethodCall_MethodTable,
+        BenchObject::IndexMode::MethodTable, METHOD_CALL);
+BENCHMARK_CAPTURE(BM_IndexWithProperties, MethodCall_Function,
+        BenchPropertyObject::IndexMode::Function, METHOD_CALL);
+BENCHMARK_CAPTURE(BM_IndexWithProperties, MethodCall_MethodTable,
+        BenchPropertyObject::IndexMode::MethodTable, METHOD_CALL);
+BENCHMARK_CAPTURE(BM_IndexWithProperties, PropertyRead_Function,
+        BenchPropertyObject::IndexMode::Function, PROPERTY_READ);
+BENCHMARK_CAPTURE(BM_IndexWithProperties, PropertyRead_MethodTable,
+        BenchPropertyObject::IndexMode::MethodTable, PROPERTY_READ);
+BENCHMARK_CAPTURE(BM_IndexWithDeclaredProperties, MethodCall_Function,
+        BenchDeclaredPropertyObject::IndexMode::Function, METHOD_CALL);
+BENCHMARK_CAPTURE(BM_IndexWithDeclaredProperties, PropertyRead_Function,
+        BenchDeclaredPropertyObject::IndexMode::Function, PROPERTY_READ);
+BENCHMARK_CAPTURE(BM_IndexWithDeclaredProperties, PropertyRead_MethodTable,
+        BenchDeclaredPropertyObject::IndexMode::MethodTable, PROPERTY_READ);
+BENCHMARK_CAPTURE(BM_IndexWithDeclaredProperties, PropertyWrite_Function,
+        BenchDeclaredPropertyObject::IndexMode::Function, PROPERTY_WRITE);
+BENCHMARK_CAPTURE(BM_Index, IndexMiss_Function,
+        BenchObject::IndexMode::Function, INDEX_MISS);
+BENCHMARK_CAPTURE(BM_Index, IndexMiss_MethodTable,
+        BenchObject::IndexMode::MethodTable, INDEX_MISS);
+BENCHMARK_CAPTURE(BM_IndexWithDeclaredProperties, IndexMiss_Function,
+        BenchDeclaredPropertyObject::IndexMode::Function, INDEX_MISS);
+BENCHMARK_CAPTURE(BM_IndexWithDeclaredProperties, IndexMiss_MethodTable,
+        BenchDeclaredPropertyObject::IndexMode::MethodTable, INDEX_MISS);
+
+static void BM_Results(benchmark::State& state, const char* script)
+{
+    runIndexBench<BenchResultsObject>(state, BenchResultsObject::IndexMode::Function, script);
+}
+
+BENCHMARK_CAPTURE(BM_Results, Tuple,
+        "local o = o; " LUA_BENCH_FOR "local x, y = o:GetPosition() end");
+BENCHMARK_CAPTURE(BM_Results, Json,
+        "local o = o; " LUA_BENCH_FOR "local p = o:GetPositionJson(); local x, y = p.x, p.y end");
+
+static void BM_Overloads(benchmark::State& state, const char* script)
+{
+    runIndexBench<BenchOverloadObject>(state, BenchOverloadObject::IndexMode::Function, script);
+}
+
+BENCHMARK_CAPTURE(BM_Overloads, Plain,
+        "local o = o; " LUA_BENCH_FOR "o:SetOne(i) end");
+BENCHMARK_CAPTURE(BM_Overloads, First,
+        "local o = o; " LUA_BENCH_FOR "o:Set(i) end");
+BENCHMARK_CAPTURE(BM_Overloads, Last,
+        "local o = o; " LUA_BENCH_FOR "o:Set('a', i) end");
+
+static void BM_VarArgs(benchmark::State& state, const char* script)
+{
+    runIndexBench<BenchVarArgsObject>(state, BenchVarArgsObject::IndexMode::Function, script);
+}
+
+BENCHMARK_CAPTURE(BM_VarArgs, VarArgs,
+        "local o = o; " LUA_BENCH_FOR "o:AddItems('a', 'b', 'c', 'd') end");
+BENCHMARK_CAPTURE(BM_VarArgs, Json,
+        "local o = o; " LUA_BENCH_FOR "o:AddItemsJson({'a', 'b', 'c', 'd'}) end");
+
+static void BM_Errors(benchmark::State& state, const char* script)
+{
+    runIndexBench<BenchErrorObject>(state, BenchErrorObject::IndexMode::Function, script);
+}
+
+BENCHMARK_CAPTURE(BM_Errors, Plain,
+        "local o = o; " LUA_BENCH_FOR "o:Add(i, 'a') end");
+BENCHMARK_CAPTURE(BM_Errors, Result,
+        "local o = o; " LUA_BENCH_FOR "o:AddChecked(i, 'a') end");
+
+static void BM_TestThis(benchmark::State& state)
+{
+    LuaBenchState lua;
+    BenchObject o;
+    BenchObject::Lua_Register(lua.L);
+    o.Lua_Push(lua.L);
+    for (auto _: state)
+        benchmark::DoNotOptimize(BenchObject::luaL_testthis(lua.L, -1));
+}
+
+static void BM_CheckThis(benchmark::State& state)
+{
+    LuaBenchState lua;
+    BenchObject o;
+    BenchObject::Lua_Register(lua.L);
+    o.Lua_Push(lua.L);
+    for (auto _: state)
+        benchmark::DoNotOptimize(BenchObject::luaL_checkthis(lua.L, -1));
+}
+
+static void BM_TestUData(benchmark::State& state)
+{
+    // what luaL_testthis used before caching the metatable
+    LuaBenchState lua;
+    BenchObject o;
+    BenchObject::Lua_Register(lua.L);
+    o.Lua_Push(lua.L);
+    for (auto _: state)
+        benchmark::DoNotOptimize(luaL_testudata(lua.L, -1, "BenchObject"));
+}
+
+BENCHMARK(BM_TestThis);
+BENCHMARK(BM_CheckThis);
+BENCHMARK(BM_TestUData);
+
+class BenchCachedObject : public LuaInterface<BenchCachedObject> {
+    friend class LuaInterface;
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "BenchCachedObject";
+    static constexpr bool Lua_CacheInstances = true;
+    static const MethodMap Lua_Methods;
+};
+
+const LuaInterface<BenchCachedObject>::MethodMap BenchCachedObject::Lua_Methods = {};
+
+template <class T>
+static void runPushBench(benchmark::State& state)
+{
+    LuaBenchState lua;
+    T o;
+    T::Lua_Register(lua.L);
+    for (auto _: state) {
+        for (int i = 0; i < LUA_BENCH_LOOP; i++) {
+            o.Lua_Push(lua.L);
+            lua_pop(lua.L, 1);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * LUA_BENCH_LOOP);
+}
+
+static void BM_Push(benchmark::State& state)
+{
+    runPushBench<BenchObject>(state);
+}
+
+static void BM_PushCached(benchmark::State& state)
+{
+    runPushBench<BenchCachedObject>(state);
+}
+
+BENCHMARK(BM_Push);
+BENCHMARK(BM_PushCached);
+
+static void BM_FunctionCall(benchmark::State& state)
+{
+    LuaBenchState lua;
+    LuaGlue::newlib(lua.L, {
+        LUA_FUNCTION(BenchGet, void),
+    });
+    lua_setglobal(lua.L, "mod");
+    lua.run(state, "local f = mod.BenchGet; " LUA_BENCH_FOR "f() end");
+}
+
+BENCHMARK(BM_FunctionCall);
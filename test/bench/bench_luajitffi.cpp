@@ -0,0 +1,58 @@
+#include "luabenchbase.hpp"
+#include "../../luainterface.h"
+#include "../../luamethod.h"
+#include "../../luajitffi.h"
+
+
+// scalar method calls through LuaMethod vs. LuaJIT FFI trampolines, see luajitffi.h
+// ReSharper disable CppMemberFunctionMayBeStatic
+class BenchFFIObject : public LuaInterface<BenchFFIObject> {
+    friend class LuaInterface;
+
+public:
+    int _value = 0;
+
+    int Add(int a, int b) const
+    {
+        return a + b;
+    }
+
+    void SetValue(int value)
+    {
+        _value = value;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "BenchFFIObject";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(BenchFFIObject, Add, int, int),
+        LUA_METHOD(BenchFFIObject, SetValue, int),
+    });
+};
+
+static void BM_FFI(benchmark::State& state, const bool ffi, const char* script)
+{
+    LuaBenchState lua;
+    luaL_openlibs(lua.L); // for require "ffi"
+    BenchFFIObject::Lua_Register(lua.L, BenchFFIObject::IndexMode::MethodTable);
+    if (ffi && !LuaGlue::setffimethods<BenchFFIObject>(lua.L, {
+            LUA_FFI_METHOD(BenchFFIObject, Add),
+            LUA_FFI_METHOD(BenchFFIObject, SetValue)})) {
+        state.SkipWithError("ffi not available");
+        return;
+    }
+    BenchFFIObject o;
+    o.Lua_Push(lua.L);
+    lua_setglobal(lua.L, "o");
+    lua.run(state, script);
+}
+
+#define FFI_ADD "local o, n = o, 0; " LUA_BENCH_FOR "n = n + o:Add(i, 1) end"
+#define FFI_SET "local o = o; " LUA_BENCH_FOR "o:SetValue(i) end"
+
+BENCHMARK_CAPTURE(BM_FFI, Add_LuaMethod, false, FFI_ADD);
+BENCHMARK_CAPTURE(BM_FFI, SetValue_LuaMethod, false, FFI_SET);
+#ifdef LUACOMPAT_LUAJIT
+BENCHMARK_CAPTURE(BM_FFI, Add_FFI, true, FFI_ADD);
+BENCHMARK_CAPTURE(BM_FFI, SetValue_FFI, true, FFI_SET);
+#endif
@@ -0,0 +1,141 @@
+#include <string>
+#include <utility>
+#include "luabenchbase.hpp"
+#include "../../luainterface.h"
+#include "../../luamethod.h"
+
+
+// argument fetching of LuaMethod for 0 to 4 arguments of each supported type
+// the method is called as f(o, ...) so the numbers do not include the __index lookup, see BM_Index for that
+// LuaRef is not included, since the method would have to unref every argument
+
+// ReSharper disable CppMemberFunctionMayBeStatic
+class BenchArgsObject : public LuaInterface<BenchArgsObject> {
+    friend class LuaInterface;
+
+public:
+    template <typename... A>
+    int Take(A...) const
+    {
+        return (int)sizeof...(A);
+    }
+
+    int Thread(lua_State *L) const
+    {
+        return L != nullptr;
+    }
+
+    LuaYield Pause() const
+    {
+        return LuaYield();
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "BenchArgsObject";
+    static const MethodMap Lua_Methods;
+};
+
+const LuaInterface<BenchArgsObject>::MethodMap BenchArgsObject::Lua_Methods = {
+    LUA_METHOD(BenchArgsObject, Thread, lua_State*),
+    LUA_METHOD(BenchArgsObject, Pause, void),
+};
+
+template <typename A, size_t>
+using BenchRepeat = A;
+
+template <typename A, size_t... I>
+static lua_CFunction benchArgsFunc(std::index_sequence<I...>)
+{
+    return LuaMethod<BenchArgsObject, &BenchArgsObject::Take<BenchRepeat<A, I>...>, BenchRepeat<A, I>...>::Func;
+}
+
+template <typename A, size_t N>
+static void BM_Args(benchmark::State& state, const std::string& value)
+{
+    LuaBenchState lua;
+    BenchArgsObject o;
+    BenchArgsObject::Lua_Register(lua.L);
+    o.Lua_Push(lua.L);
+    lua_setglobal(lua.L, "o");
+    lua_pushcfunction(lua.L, benchArgsFunc<A>(std::make_index_sequence<N>()));
+    lua_setglobal(lua.L, "f");
+    std::string script = "local f, o, v = f, o, " + value + "; " LUA_BENCH_FOR "f(o";
+    for (size_t i = 0; i < N; i++)
+        script += ", v";
+    script += ") end";
+    lua.run(state, script.c_str());
+}
+
+template <typename A, size_t... N>
+static bool registerArgs(const char* type, const char* value, std::index_sequence<N...>)
+{
+    int dummy[] = {0, (benchmark::RegisterBenchmark(
+            ("BM_Args/" + std::string(type) + "/" + std::to_string(N + 1)).c_str(), BM_Args<A, N + 1>, value), 0)...};
+    (void)dummy;
+    return true;
+}
+
+// 1 to 4 arguments, value is a Lua expression evaluated once per run
+template <typename A>
+static bool registerArgs(const char* type, const char* value)
+{
+    return registerArgs<A>(type, value, std::make_index_sequence<4>());
+}
+
+static void BM_ArgsNone(benchmark::State& state)
+{
+    BM_Args<void, 0>(state, "nil");
+}
+
+BENCHMARK(BM_ArgsNone);
+
+static const bool argsRegistered = registerArgs<int>("int", "1")
+        && registerArgs<unsigned>("unsigned", "1")
+        && registerArgs<int64_t>("int64", "1")
+        && registerArgs<double>("double", "1.5")
+        && registerArgs<bool>("bool", "true")
+        && registerArgs<const char*>("cstring", "'abc'")
+        && registerArgs<std::string_view>("string_view", "'abc'")
+        && registerArgs<LuaVariant>("LuaVariant", "'abc'")
+        && registerArgs<LuaVariant>("LuaVariantTable", "{}")
+        && registerArgs<json>("json", "{x = 1, y = 2}");
+
+// lua_State* argument, should cost the same as no argument
+static void BM_ArgsState(benchmark::State& state)
+{
+    LuaBenchState lua;
+    BenchArgsObject o;
+    BenchArgsObject::Lua_Register(lua.L);
+    o.Lua_Push(lua.L);
+    lua_setglobal(lua.L, "o");
+    lua.run(state, "local o = o; local f = o.Thread; " LUA_BENCH_FOR "f(o) end");
+}
+
+BENCHMARK(BM_ArgsState);
+
+// LuaYield from a method and lua_resume from C++, per round trip
+static void BM_YieldResume(benchmark::State& state)
+{
+    LuaBenchState lua;
+    BenchArgsObject o;
+    BenchArgsObject::Lua_Register(lua.L);
+    o.Lua_Push(lua.L);
+    lua_setglobal(lua.L, "o");
+    lua_State *co = lua_newthread(lua.L);
+    if (luaL_loadstring(co, "local o = o; local f = o.Pause; while true do f(o) end") != LUA_OK) {
+        state.SkipWithError(lua_tostring(co, -1));
+        return;
+    }
+    int nres;
+    for (auto _: state) {
+        for (int i = 0; i < LUA_BENCH_LOOP; i++) {
+            if (lua_resume(co, lua.L, 0, &nres) != LUA_YIELD) {
+                state.SkipWithError(lua_tostring(co, -1));
+                return;
+            }
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * LUA_BENCH_LOOP);
+}
+
+BENCHMARK(BM_YieldResume);
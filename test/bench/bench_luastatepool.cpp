@@ -0,0 +1,91 @@
+#include <memory>
+#include "luabenchbase.hpp"
+#include "../../luainterface.h"
+#include "../../luamethod.h"
+#include "../../luastatepool.h"
+
+
+// state creation from a LuaManifest, and script throughput of a LuaStatePool with more threads
+// ReSharper disable CppMemberFunctionMayBeStatic
+class BenchPoolObject : public LuaInterface<BenchPoolObject> {
+    friend class LuaInterface;
+
+public:
+    int Add(int a, int b) const
+    {
+        return a + b;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "BenchPoolObject";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(BenchPoolObject, Add, int, int),
+    });
+};
+
+enum class BenchPoolEnum {
+    A,
+    B,
+};
+
+static LuaManifest benchManifest()
+{
+    LuaManifest manifest;
+    manifest.OpenLibs()
+            .Register<BenchPoolObject>(BenchPoolObject::IndexMode::MethodTable)
+            .Enum("E", LuaEnum<BenchPoolEnum>({{"A", BenchPoolEnum::A}, {"B", BenchPoolEnum::B}}))
+            .Global("NAME", "bench")
+            .Call([](lua_State *L) {
+                BenchPoolObject::Lua_New(L);
+                lua_setglobal(L, "o");
+            });
+    return manifest;
+}
+
+// one state, created and closed per iteration
+static void BM_ManifestNewState(benchmark::State& state)
+{
+    const LuaManifest manifest = benchManifest();
+    for (auto _: state) {
+        lua_State *L = manifest.NewState();
+        benchmark::DoNotOptimize(L);
+        lua_close(L);
+    }
+}
+
+BENCHMARK(BM_ManifestNewState);
+
+// pool of 16 states, created with 1, 2, 4 or 8 threads
+static void BM_PoolCreate(benchmark::State& state)
+{
+    const LuaManifest manifest = benchManifest();
+    for (auto _: state) {
+        LuaStatePool pool(manifest, 16, static_cast<size_t>(state.range(0)));
+        benchmark::DoNotOptimize(pool.size());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * 16);
+}
+
+BENCHMARK(BM_PoolCreate)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+// checkout, run, return on 1 to 8 benchmark threads sharing a pool with one state per thread
+static std::unique_ptr<LuaStatePool> benchPool;
+
+static void BM_PoolThroughput(benchmark::State& state)
+{
+    if (state.thread_index() == 0)
+        benchPool.reset(new LuaStatePool(benchManifest(), static_cast<size_t>(state.threads())));
+    static constexpr char script[] = "local o, n = o, 0; " LUA_BENCH_FOR "n = n + o:Add(i, 1) end";
+    for (auto _: state) {
+        auto L = benchPool->Checkout();
+        if (luaL_loadbuffer(L, script, sizeof(script) - 1, "bench") != LUA_OK || lua_pcall(L, 0, 0, 0) != LUA_OK) {
+            state.SkipWithError(lua_tostring(L, -1));
+            break;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * LUA_BENCH_LOOP);
+    if (state.thread_index() == 0)
+        benchPool.reset();
+}
+
+BENCHMARK(BM_PoolThroughput)->ThreadRange(1, 8)->UseRealTime();
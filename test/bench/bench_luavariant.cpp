@@ -0,0 +1,59 @@
+#include <string>
+#include "luabenchbase.hpp"
+#include "../../luavariant.h"
+
+
+// longer than LuaVariant::InlineSize, as Lua literal
+static const std::string longString = "'" + std::string(100, 'x') + "'";
+
+// LuaVariant Lua_Get (or Lua_Borrow) + Lua_Push of the value produced by a Lua expression
+static void BM_VariantRoundTrip(benchmark::State& state, const char* value, const bool borrow)
+{
+    LuaBenchState lua;
+    const std::string script = std::string("return ") + value;
+    if (luaL_dostring(lua.L, script.c_str()) != LUA_OK) {
+        state.SkipWithError(lua_tostring(lua.L, -1));
+        return;
+    }
+    for (auto _: state) {
+        for (int i = 0; i < LUA_BENCH_LOOP; i++) {
+            LuaVariant v;
+            if (borrow)
+                v.Lua_Borrow(lua.L, -1);
+            else
+                v.Lua_Get(lua.L, -1);
+            v.Lua_Push(lua.L);
+            lua_pop(lua.L, 1);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * LUA_BENCH_LOOP);
+}
+
+BENCHMARK_CAPTURE(BM_VariantRoundTrip, Integer, "42", false);
+BENCHMARK_CAPTURE(BM_VariantRoundTrip, Number, "1.5", false);
+BENCHMARK_CAPTURE(BM_VariantRoundTrip, Boolean, "true", false);
+BENCHMARK_CAPTURE(BM_VariantRoundTrip, ShortString, "'short string'", false);
+BENCHMARK_CAPTURE(BM_VariantRoundTrip, LongString, longString.c_str(), false);
+BENCHMARK_CAPTURE(BM_VariantRoundTrip, LongStringBorrowed, longString.c_str(), true);
+BENCHMARK_CAPTURE(BM_VariantRoundTrip, Table, "{1, 2, 3}", false);
+
+// copies of a variant, e.g. when stored in containers
+static void BM_VariantCopy(benchmark::State& state, const char* value)
+{
+    LuaBenchState lua;
+    const std::string script = std::string("return ") + value;
+    if (luaL_dostring(lua.L, script.c_str()) != LUA_OK) {
+        state.SkipWithError(lua_tostring(lua.L, -1));
+        return;
+    }
+    LuaVariant v;
+    v.Lua_Get(lua.L, -1);
+    for (auto _: state) {
+        LuaVariant copy = v;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+BENCHMARK_CAPTURE(BM_VariantCopy, ShortString, "'short string'");
+BENCHMARK_CAPTURE(BM_VariantCopy, LongString, longString.c_str());
+BENCHMARK_CAPTURE(BM_VariantCopy, Table, "{1, 2, 3}");
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <benchmark/benchmark.h>
+#include "../../lua_include.h"
+#include "../../luacompat.h"
+
+
+// number of calls done inside one Lua chunk, to get the chunk call overhead out of the measurement
+#define LUA_BENCH_LOOP 1000
+#define LUA_BENCH_STRINGIFY(s) LUA_BENCH_STRINGIFY_(s)
+#define LUA_BENCH_STRINGIFY_(s) #s
+#define LUA_BENCH_FOR "for i=1," LUA_BENCH_STRINGIFY(LUA_BENCH_LOOP) " do "
+
+
+// added to the context of the json output, so results of different builds can be told apart
+inline const bool luaBenchContext = (
+    benchmark::AddCustomContext("lua_version_num", std::to_string(LUA_VERSION_NUM)),
+#if defined __cpp_exceptions || defined __EXCEPTIONS || defined _CPPUNWIND
+    benchmark::AddCustomContext("exceptions", "on"),
+#else
+    benchmark::AddCustomContext("exceptions", "off"),
+#endif
+    true);
+
+
+class LuaBenchState {
+public:
+    lua_State* L;
+
+    LuaBenchState()
+    {
+        L = luaL_newstate();
+    }
+
+    ~LuaBenchState()
+    {
+        lua_close(L);
+        L = nullptr;
+    }
+
+    LuaBenchState(const LuaBenchState&) = delete;
+    LuaBenchState& operator=(const LuaBenchState&) = delete;
+
+    // compiles s and runs it once per benchmark iteration; s should loop LUA_BENCH_LOOP times
+    void run(benchmark::State& state, const char* s) const
+    {
+        if (luaL_loadstring(L, s) != LUA_OK) {
+            state.SkipWithError(lua_tostring(L, -1));
+            return;
+        }
+        for (auto _: state) {
+            lua_pushvalue(L, -1);
+            if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
+                state.SkipWithError(lua_tostring(L, -1));
+                break;
+            }
+        }
+        lua_settop(L, 0);
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * LUA_BENCH_LOOP);
+    }
+};
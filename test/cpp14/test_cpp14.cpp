@@ -0,0 +1,182 @@
+// built with -std=c++14 by test.sh, luamethod.h picks _luamethod.14.h on its own
+// LuaInterface needs C++17, so methods are bound to a plain userdata here
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <tuple>
+#include <utility>
+#include "../luatestbase.hpp"
+#include "../macros.hpp"
+#include "../../luamethod.h"
+
+
+// constexpr static members are only inline since C++17, one translation unit has to define them
+constexpr const char LuaJson_EmptyArray::Lua_Name[];
+
+static int add(int a, int b)
+{
+    return a + b;
+}
+
+static json object(const char* key, double value)
+{
+    return json{{key, value}};
+}
+
+// ReSharper disable CppMemberFunctionMayBeStatic
+class Cpp14Counter final {
+public:
+    static constexpr const char* Lua_Name = "Cpp14Counter";
+
+    int value = 0;
+
+    int Add(int n)
+    {
+        value += n;
+        return value;
+    }
+
+    LuaResult<int> Checked(int n) const
+    {
+        if (n < 0)
+            return LuaError("negative");
+        return n * 2;
+    }
+
+    std::pair<std::string, bool> Describe(const char* prefix) const
+    {
+        return {prefix + std::to_string(value), value > 0};
+    }
+
+    LuaVariant Echo(LuaVariant v) const
+    {
+        return v;
+    }
+
+    int Count(LuaVarArgs args) const
+    {
+        return static_cast<int>(args.size());
+    }
+
+    LuaResult<int64_t> Sum(LuaVarArgs args) const
+    {
+        int64_t sum = 0;
+        for (const auto arg : args) {
+            const auto v = arg.tryInteger();
+            if (!v)
+                return LuaError(v.error());
+            sum += v.value();
+        }
+        return sum;
+    }
+
+    void Set(int v)
+    {
+        value = v;
+    }
+
+    void Set(const char* s)
+    {
+        value = atoi(s);
+    }
+
+    static std::string Name()
+    {
+        return Lua_Name;
+    }
+
+    static Cpp14Counter* luaL_checkthis(lua_State *L, int idx)
+    {
+        return static_cast<Cpp14Counter *>(luaL_checkudata(L, idx, Lua_Name));
+    }
+
+    static void Lua_Register(lua_State *L)
+    {
+        luaL_newmetatable(L, Lua_Name);
+        LuaGlue::newlib(L, {
+            LUA_METHOD(Cpp14Counter, Add, int),
+            LUA_METHOD(Cpp14Counter, Checked, int),
+            LUA_METHOD(Cpp14Counter, Describe, const char*),
+            LUA_METHOD(Cpp14Counter, Echo, LuaVariant),
+            LUA_METHOD(Cpp14Counter, Count, LuaVarArgs),
+            LUA_METHOD(Cpp14Counter, Sum, LuaVarArgs),
+            LUA_OVERLOADS(Cpp14Counter, Set, void(int), void(const char*)),
+            LUA_STATIC_METHOD(Cpp14Counter, Name, void),
+        });
+        lua_setfield(L, -2, "__index");
+        lua_pop(L, 1);
+    }
+
+    // trivially destructible, no __gc needed
+    static Cpp14Counter* Lua_New(lua_State *L)
+    {
+        auto o = new (lua_newuserdata(L, sizeof(Cpp14Counter))) Cpp14Counter();
+        luaL_setmetatable(L, Lua_Name);
+        return o;
+    }
+};
+
+class Cpp14Test : public LuaTestBase {
+protected:
+    Cpp14Counter *counter;
+
+    Cpp14Test()
+    {
+        Cpp14Counter::Lua_Register(L);
+        counter = Cpp14Counter::Lua_New(L);
+        lua_setglobal(L, "counter");
+        LuaGlue::newlib(L, {
+            LUA_FUNCTION(add, int, int),
+            LUA_FUNCTION(object, const char*, double),
+        });
+        lua_setglobal(L, "lib");
+    }
+};
+
+TEST_F(Cpp14Test, LongForm) {
+#ifdef LUA_METHOD_LONG_FORM
+    SUCCEED();
+#else
+    FAIL() << "luamethod.h did not select the long form";
+#endif
+}
+
+TEST_F(Cpp14Test, Methods) {
+    ASSERT_TRUE(doString(
+            "assert(counter:Add(2) == 2 and counter:Add(3) == 5)\n"
+            "local s, positive = counter:Describe('n=')\n"
+            "assert(s == 'n=5' and positive == true, s)\n"
+            "assert(counter:Checked(4) == 8)\n"
+            "assert(counter:Echo('a long string, not stored inline') == 'a long string, not stored inline')\n"
+            "local t = {}; assert(counter:Echo(t) == t and counter:Echo(1.5) == 1.5)\n"
+            "assert(counter:Count(1, 'a', nil, {}) == 4 and counter:Count() == 0)\n"
+            "assert(counter:Sum(1, 2, 3) == 6 and counter:Sum() == 0)\n"
+            "counter:Set(7); assert(counter:Add(0) == 7)\n"
+            "counter:Set('9'); assert(counter:Add(0) == 9)\n"
+            "assert(counter.Name() == 'Cpp14Counter')\n"));
+    EXPECT_EQ(counter->value, 9);
+    EXPECT_EQ(lua_gettop(L), 0);
+}
+
+TEST_F(Cpp14Test, Functions) {
+    ASSERT_TRUE(doString(
+            "assert(lib.add(1, 2) == 3)\n"
+            "assert(lib.object('x', 1.5).x == 1.5)\n"));
+}
+
+TEST_F(Cpp14Test, Errors) {
+    EXPECT_FALSE(doString("counter:Checked(-1)"));
+    EXPECT_NE(std::string(lua_tostring(L, -1)).find("negative"), std::string::npos);
+    lua_pop(L, 1);
+    EXPECT_FALSE(doString("counter:Add('x')"));
+    lua_pop(L, 1);
+    EXPECT_FALSE(doString("counter:Sum(1, 'x')"));
+    EXPECT_NE(std::string(lua_tostring(L, -1)).find("bad argument #2 to 'Sum' (number expected, got string)"),
+              std::string::npos) << lua_tostring(L, -1);
+    lua_pop(L, 1);
+    EXPECT_FALSE(doString("counter:Set(true)"));
+    EXPECT_NE(std::string(lua_tostring(L, -1)).find("Set(integer) Set(string)"), std::string::npos);
+    lua_pop(L, 1);
+    EXPECT_EQ(lua_gettop(L), 0);
+}
@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include "../luatestbase.hpp"
+#include "../macros.hpp"
+#include "../../luacompat.h" // lua_isnumber for < 5.3
+#include "../../lua_json.h"
+
+
+#ifdef USE_EXCEPTIONS
+#   define EXPECT_RECURSIVE(statement, typeCheck) \
+        EXPECT_THROW(statement, std::runtime_error);
+#else
+#   define EXPECT_RECURSIVE(statement, typeCheck) \
+        { statement; EXPECT_TRUE(typeCheck(L, -1)); }
+#endif
+
+
+class JsonTextToLuaTest : public LuaTestBase {
+protected:
+    NODISCARD
+    bool parse(const std::string& s, const int maxDepth = 1000) const
+    {
+        return json_text_to_lua(L, s.data(), s.size(), maxDepth);
+    }
+};
+
+TEST_F(JsonTextToLuaTest, Array) {
+    EXPECT_TRUE(parse("[2, null, \"x\"]"));
+    ASSERT_EQ(lua_gettop(L), 1);
+    EXPECT_EQ(lua_type(L, -1), LUA_TTABLE);
+    lua_geti(L, -1, 1);
+    EXPECT_EQ(lua_tointeger(L, -1), 2);
+    lua_geti(L, -2, 2);
+    EXPECT_TRUE(lua_isnil(L, -1));
+    lua_geti(L, -3, 3);
+    EXPECT_STREQ(lua_tostring(L, -1), "x");
+}
+
+TEST_F(JsonTextToLuaTest, Dict) {
+    EXPECT_TRUE(parse(R"({"a": 2, "b": {"c": [true, false]}})"));
+    ASSERT_EQ(lua_gettop(L), 1);
+    EXPECT_EQ(lua_type(L, -1), LUA_TTABLE);
+    lua_getfield(L, -1, "a");
+    EXPECT_EQ(lua_tointeger(L, -1), 2);
+    lua_getfield(L, -2, "b");
+    lua_getfield(L, -1, "c");
+    lua_geti(L, -1, 1);
+    EXPECT_EQ(lua_type(L, -1), LUA_TBOOLEAN);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+TEST_F(JsonTextToLuaTest, Scalars) {
+    EXPECT_TRUE(parse("\"Test\""));
+    EXPECT_STREQ(lua_tostring(L, -1), "Test");
+    EXPECT_TRUE(parse("\"a\\u0000b\""));
+    size_t len;
+    lua_tolstring(L, -1, &len);
+    EXPECT_EQ(len, 3u);
+    EXPECT_TRUE(parse("1.23"));
+    EXPECT_DOUBLE_EQ(lua_tonumber(L, -1), static_cast<lua_Number>(1.23));
+    EXPECT_TRUE(parse("null"));
+    EXPECT_TRUE(lua_isnil(L, -1));
+    EXPECT_EQ(lua_gettop(L), 4);
+}
+
+TEST_F(JsonTextToLuaTest, SameAsJsonToLua) {
+    // numbers are mapped the same way as json_to_lua
+    const std::string s = "[-9223372036854775808, 9223372036854775807, 18446744073709551615, 2147483648, 1.5]";
+    EXPECT_TRUE(parse(s));
+    json_to_lua(L, json::parse(s));
+    for (int i = 1; i <= 5; i++) {
+        lua_geti(L, 1, i);
+        lua_geti(L, 2, i);
+        EXPECT_EQ(lua_isinteger(L, -1), lua_isinteger(L, -2)) << i;
+        EXPECT_TRUE(lua_rawequal(L, -1, -2)) << i;
+        lua_pop(L, 2);
+    }
+    EXPECT_EQ(lua_to_json(L, 1), lua_to_json(L, 2));
+}
+
+TEST_F(JsonTextToLuaTest, Invalid) {
+    lua_pushinteger(L, 1);
+#ifdef USE_EXCEPTIONS
+    EXPECT_THROW((void)parse(R"({"a": [1, 2)"), json::parse_error);
+    EXPECT_EQ(lua_gettop(L), 1);
+#else
+    EXPECT_FALSE(parse(R"({"a": [1, 2)"));
+    EXPECT_EQ(lua_gettop(L), 2);
+    EXPECT_TRUE(lua_isnil(L, -1));
+#endif
+}
+
+TEST_F(JsonTextToLuaTest, MaxDepth) {
+    EXPECT_TRUE(parse("[[[1]]]", 4));
+    lua_pop(L, 1);
+#ifdef USE_EXCEPTIONS
+    EXPECT_THROW((void)parse("[[[1]]]", 3), std::runtime_error);
+    EXPECT_EQ(lua_gettop(L), 0);
+#else
+    EXPECT_TRUE(parse("[[[1], 2]]", 3));
+    EXPECT_EQ(lua_to_json(L, -1).dump(), "[[null,2]]");
+#endif
+}
+
+TEST_F(JsonTextToLuaTest, StackOverflow) {
+    // how much room is left near the limit depends on the Lua version, so only the invariants are checked:
+    // failing leaves the stack as it was, containers that don't fit are nil and the rest of their parent is kept
+    while (lua_checkstack(L, 1))
+        lua_pushboolean(L, 1);
+    for (int i = 0; i < 8; i++) {
+        const int top = lua_gettop(L);
+        for (const char* text: {"5", "[1, [2], 3]"}) {
+#ifdef USE_EXCEPTIONS
+            bool ok;
+            try {
+                ok = parse(text);
+            } catch (const std::runtime_error&) {
+                ok = false;
+            }
+#else
+            const bool ok = parse(text);
+#endif
+            if (!ok) {
+                EXPECT_EQ(lua_gettop(L), top) << text;
+                continue;
+            }
+            ASSERT_EQ(lua_gettop(L), top + 1) << text;
+            if (lua_istable(L, -1)) {
+                lua_rawgeti(L, -1, 1);
+                lua_rawgeti(L, -2, 2);
+                lua_rawgeti(L, -3, 3);
+                EXPECT_EQ(lua_tointeger(L, -3), 1);
+                EXPECT_TRUE(lua_isnil(L, -2) || lua_istable(L, -2));
+                EXPECT_EQ(lua_tointeger(L, -1), 3);
+            } else {
+                EXPECT_TRUE(lua_isnil(L, -1) || lua_tointeger(L, -1) == 5) << text;
+            }
+            lua_settop(L, top);
+        }
+        lua_pop(L, 1);
+    }
+    lua_settop(L, 0);
+}
+
+TEST_F(JsonTextToLuaTest, ArrayTooDeep) {
+    std::string s = std::string(100000, '[') + std::string(100000, ']');
+    EXPECT_RECURSIVE((void)parse(s), lua_istable);
+#ifdef USE_EXCEPTIONS
+    EXPECT_EQ(lua_gettop(L), 0);
+#else
+    EXPECT_EQ(lua_gettop(L), 1);
+#endif
+}
+
+TEST_F(JsonTextToLuaTest, MixedTooDeep) {
+    std::string s;
+    for (unsigned n = 0; n < 100000; n++)
+        s += "{\"a\":[";
+    for (unsigned n = 0; n < 100000; n++)
+        s += "]}";
+    EXPECT_RECURSIVE((void)parse(s), lua_istable);
+#ifdef USE_EXCEPTIONS
+    EXPECT_EQ(lua_gettop(L), 0);
+#else
+    EXPECT_EQ(lua_gettop(L), 1);
+#endif
+}
+
+TEST_F(JsonTextToLuaTest, StringView) {
+    // only the view is parsed, the rest of the buffer is ignored
+    const char buf[] = R"({"a\u0000b": "c\u0000d"} trailing)";
+    EXPECT_TRUE(json_text_to_lua(L, std::string_view(buf, 24)));
+    ASSERT_EQ(lua_gettop(L), 1);
+    lua_pushlstring(L, "a\0b", 3);
+    lua_rawget(L, -2);
+    size_t len = 0;
+    const char* s = lua_tolstring(L, -1, &len);
+    ASSERT_NE(s, nullptr);
+    EXPECT_EQ(std::string(s, len), std::string("c\0d", 3));
+}
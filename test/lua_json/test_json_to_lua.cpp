@@ -31,6 +31,15 @@ TEST_F(JsonToLuaTest, Dict) {
     EXPECT_EQ(lua_tointeger(L, -1), 2);
 }
 
+TEST_F(JsonToLuaTest, DictKeyWithNul) {
+    json j = json::object();
+    j[std::string("a\0b", 3)] = 1;
+    json_to_lua(L, j);
+    lua_pushlstring(L, "a\0b", 3);
+    lua_rawget(L, -2);
+    EXPECT_EQ(lua_tointeger(L, -1), 1);
+}
+
 TEST_F(JsonToLuaTest, String) {
     const std::string val = "Test";
     json_to_lua(L, val);
@@ -146,3 +155,17 @@ TEST_F(JsonToLuaTest, MixedTooDeep) {
     EXPECT_EQ(lua_gettop(L), 1);
 #endif
 }
+
+TEST_F(JsonToLuaTest, DeepBeyondDefault) {
+    // nesting is only limited by maxDepth and the Lua stack, not the native stack
+    std::string s = std::string(3000, '[') + "1" + std::string(3000, ']');
+    json_to_lua(L, json::parse(s), 4000);
+    ASSERT_EQ(lua_gettop(L), 1);
+    for (unsigned n = 1; n < 3000; n++) {
+        lua_rawgeti(L, -1, 1);
+        ASSERT_TRUE(lua_istable(L, -1));
+        lua_replace(L, 1);
+    }
+    lua_rawgeti(L, -1, 1);
+    EXPECT_EQ(lua_tointeger(L, -1), 1);
+}
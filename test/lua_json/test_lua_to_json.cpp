@@ -208,3 +208,173 @@ TEST_F(LuaToJsonTest, Integer) {
         FAIL() << "Unsupported lua_Number size";
     }
 }
+
+TEST_F(LuaToJsonTest, Sequence) {
+    ASSERT_TRUE(doString(R""""(
+        return {1, 2.5, "three", {4}, true}, {1, 2, 3, x = 4}, {1, 2, nil, 4}
+    )""""));
+    ASSERT_EQ(lua_gettop(L), 3);
+    EXPECT_EQ(lua_to_json(L, 1).dump(), R""""([1,2.5,"three",[4],true])"""");
+    auto j = lua_to_json(L, 2);
+    EXPECT_TRUE(j.is_object());
+    EXPECT_EQ(j["3"], 3);
+    EXPECT_EQ(j["x"], 4);
+    EXPECT_EQ(lua_to_json(L, 3).dump(), "[1,2,null,4]");
+    EXPECT_EQ(lua_gettop(L), 3);
+}
+
+TEST_F(LuaToJsonTest, DeepBeyondDefault) {
+    // nesting is only limited by maxDepth and the Lua stack, not the native stack
+    ASSERT_TRUE(doString(R""""(
+        local t = {1}
+        for i = 2, 3000 do t = {t} end
+        local d = {v = 1}
+        for i = 2, 2000 do d = {v = i, next = d} end
+        return t, d
+    )""""));
+    std::string expected = std::string(3000, '[') + "1" + std::string(3000, ']');
+    EXPECT_EQ(lua_to_json(L, 1, 4000).dump(), expected);
+    auto j = lua_to_json(L, 2, 4000);
+    unsigned n = 2000;
+    for (const json* p = &j; p; n--) {
+        ASSERT_EQ((*p)["v"], n);
+        p = p->contains("next") ? &(*p)["next"] : nullptr;
+    }
+    EXPECT_EQ(n, 0u);
+    EXPECT_EQ(lua_gettop(L), 2);
+}
+
+TEST_F(LuaToJsonTest, CycleError) {
+    ASSERT_TRUE(doString(R""""(
+        x = {}
+        x[1] = {a = x}
+        return x
+    )""""));
+#ifdef USE_EXCEPTIONS
+    try {
+        lua_to_json(L, -1);
+        FAIL() << "expected exception";
+    } catch (const std::runtime_error& ex) {
+        EXPECT_STREQ(ex.what(), "Cycle detected");
+    }
+#else
+    EXPECT_EQ(lua_to_json(L, -1).dump(), R""""([{"a":null}])"""");
+#endif
+    EXPECT_EQ(lua_gettop(L), 1);
+}
+
+TEST_F(LuaToJsonTest, CycleNull) {
+    ASSERT_TRUE(doString(R""""(
+        x = {}
+        x[1] = {a = x}
+        x[2] = x
+        return x
+    )""""));
+    EXPECT_EQ(lua_to_json(L, -1, 1000, LuaJsonCycles::Null).dump(), R""""([{"a":null},null])"""");
+    EXPECT_EQ(lua_gettop(L), 1);
+}
+
+TEST_F(LuaToJsonTest, SharedIsNotACycle) {
+    ASSERT_TRUE(doString(R""""(
+        local s = {1}
+        return {s, s, b = {c = s}}
+    )""""));
+    auto j = lua_to_json(L, -1);
+    EXPECT_EQ(j["1"], json::parse("[1]"));
+    EXPECT_EQ(j["2"], json::parse("[1]"));
+    EXPECT_EQ(j["b"]["c"], json::parse("[1]"));
+    EXPECT_EQ(lua_to_json(L, -1, 1000, LuaJsonCycles::Null), j);
+}
+
+TEST_F(LuaToJsonTest, CycleReference) {
+    ASSERT_TRUE(doString(R""""(
+        local s = {1}
+        x = {s, {s}, b = {c = s}}
+        x.b.d = x
+        x.b.e = x.b
+        return x
+    )""""));
+    auto j = lua_to_json(L, -1, 1000, LuaJsonCycles::Reference);
+    EXPECT_EQ(lua_gettop(L), 1);
+    // the first table reached is converted, all others are references to the key path from the root
+    std::vector<json> refs;
+    std::vector<json> values;
+    for (const auto& v: {j["1"], j["2"][0], j["b"]["c"]}) {
+        if (v.is_object())
+            refs.push_back(v);
+        else
+            values.push_back(v);
+    }
+    ASSERT_EQ(values.size(), 1u);
+    EXPECT_EQ(values[0], json::parse("[1]"));
+    ASSERT_EQ(refs.size(), 2u);
+    EXPECT_EQ(refs[0], refs[1]);
+    EXPECT_EQ(j["b"]["d"], json::parse(R""""({"$ref":[]})""""));
+    EXPECT_EQ(j["b"]["e"], json::parse(R""""({"$ref":["b"]})""""));
+}
+
+TEST_F(LuaToJsonTest, CycleReferencePath) {
+    ASSERT_TRUE(doString(R""""(
+        x = {a = {{}, {}}}
+        x.a[2].b = x.a[1]
+        return x
+    )""""));
+    EXPECT_EQ(lua_to_json(L, -1, 1000, LuaJsonCycles::Reference).dump(),
+              R""""({"a":[{},{"b":{"$ref":["a",0]}}]})"""");
+}
+
+// value a {"$ref": [...]} marker in root refers to, resolved as JSON pointer
+static const json& resolveReference(const json& root, const json& marker)
+{
+    std::string pointer;
+    for (const auto& key: marker.at("$ref"))
+        pointer += "/" + (key.is_string() ? key.get<std::string>() : key.dump());
+    return root.at(json::json_pointer(pointer));
+}
+
+TEST_F(LuaToJsonTest, CycleReferencePointer) {
+    ASSERT_TRUE(doString(R""""(
+        local s = {"shared"}
+        return {list = {1, {2, s}}, [7] = {x = {s}}, other = s}
+    )""""));
+    for (const json& j: {lua_to_json(L, -1, 1000, LuaJsonCycles::Reference),
+                         json::parse(lua_to_json_string(L, -1, 1000, LuaJsonCycles::Reference))}) {
+        // one of them is converted, the others are references to it
+        int refs = 0;
+        for (const json* v: {&j["list"][1][1], &j["7"]["x"][0], &j["other"]}) {
+            if (v->is_object()) {
+                EXPECT_EQ(resolveReference(j, *v), json::parse(R""""(["shared"])"""")) << *v;
+                refs++;
+            }
+        }
+        EXPECT_EQ(refs, 2) << j;
+    }
+}
+
+TEST_F(LuaToJsonTest, CycleReferenceMixed) {
+    // the integer keys of a table with string keys are object keys, whichever key is reached first
+    ASSERT_TRUE(doString(R""""(
+        local s = {"shared"}
+        return {s, {s}, b = s, [4] = s}
+    )""""));
+    const json j = lua_to_json(L, -1, 1000, LuaJsonCycles::Reference);
+    ASSERT_TRUE(j.is_object()) << j;
+    int refs = 0;
+    for (const json* v: {&j["1"], &j["2"][0], &j["b"], &j["4"]}) {
+        if (v->is_object()) {
+            EXPECT_EQ(resolveReference(j, *v), json::parse(R""""(["shared"])"""")) << *v;
+            refs++;
+        }
+    }
+    EXPECT_EQ(refs, 3) << j;
+}
+
+TEST_F(LuaToJsonTest, EmbeddedNul) {
+    ASSERT_TRUE(doString(R""""(
+        return {["k\0ey"] = "va\0lue", [1.5] = 1}
+    )""""));
+    auto j = lua_to_json(L, -1);
+    EXPECT_EQ(j[std::string("k\0ey", 4)], std::string("va\0lue", 6));
+    EXPECT_EQ(j["1.5"], 1);
+    EXPECT_EQ(lua_gettop(L), 1);
+}
@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include "../luatestbase.hpp"
+#include "../macros.hpp"
+#include "../../lua_json.h"
+
+
+#ifdef USE_EXCEPTIONS
+#   define EXPECT_RECURSIVE(statement, expected) \
+        EXPECT_THROW(statement, std::runtime_error);
+#else
+#   define EXPECT_RECURSIVE(statement, expected) \
+        EXPECT_NE(statement.find(expected), std::string::npos);
+#endif
+
+
+class LuaToJsonStringTest : public LuaTestBase {
+protected:
+    // compares the streamed text with the DOM version
+    void expectSameAsDom(const int n)
+    {
+        const int top = lua_gettop(L);
+        const std::string s = lua_to_json_string(L, n);
+        EXPECT_EQ(json::parse(s), lua_to_json(L, n)) << s;
+        EXPECT_EQ(lua_gettop(L), top);
+    }
+};
+
+TEST_F(LuaToJsonStringTest, Scalars) {
+    lua_pushinteger(L, 1);
+    lua_pushinteger(L, -42);
+    lua_pushinteger(L, std::numeric_limits<lua_Integer>::min());
+    lua_pushnumber(L, 0.5);
+    lua_pushnumber(L, 1e300);
+    lua_pushboolean(L, 1);
+    lua_pushboolean(L, 0);
+    lua_pushnil(L);
+    lua_pushstring(L, "text");
+    for (int i = 1; i <= lua_gettop(L); i++) {
+        EXPECT_EQ(lua_to_json_string(L, i), lua_to_json(L, i).dump());
+    }
+}
+
+TEST_F(LuaToJsonStringTest, NonFinite) {
+    ASSERT_TRUE(doString("return {1/0, -1/0, 0/0}"));
+    EXPECT_EQ(lua_to_json_string(L, -1), "[null,null,null]");
+}
+
+TEST_F(LuaToJsonStringTest, Escape) {
+    lua_pushstring(L, "\"quoted\"\\ \b\f\n\r\t\x01\x1f\x7f \xc3\xa4");
+    EXPECT_EQ(lua_to_json_string(L, -1), lua_to_json(L, -1).dump());
+    lua_pushlstring(L, "a\0b", 3);
+    EXPECT_EQ(lua_to_json_string(L, -1), R"("a\u0000b")");
+}
+
+// documented differences to lua_to_json().dump()
+TEST_F(LuaToJsonStringTest, DomDifferences) {
+    lua_pushstring(L, "\xff");
+    EXPECT_EQ(lua_to_json_string(L, -1), "\"\xff\"");
+#ifdef USE_EXCEPTIONS
+    EXPECT_THROW((void)lua_to_json(L, -1).dump(), json::type_error);
+#endif
+    lua_pop(L, 1);
+    // integer keys keep their value
+    ASSERT_TRUE(doString("local t = {}; t[1] = 'a'; t[3] = 'b'; t.x = 1; return t"));
+    EXPECT_EQ(json::parse(lua_to_json_string(L, -1)), json::parse(R"({"1": "a", "3": "b", "x": 1})"));
+}
+
+TEST_F(LuaToJsonStringTest, Append) {
+    std::string out = "x=";
+    lua_pushinteger(L, 1);
+    lua_to_json_string(L, -1, out);
+    EXPECT_EQ(out, "x=1");
+}
+
+TEST_F(LuaToJsonStringTest, Writer) {
+    ASSERT_TRUE(doString("return {1, 2, {a = 3}}"));
+    std::string out;
+    size_t calls = 0;
+    lua_to_json_write(L, -1, [&](const char* data, size_t len) {
+        out.append(data, len);
+        calls++;
+    });
+    EXPECT_EQ(out, R"([1,2,{"a":3}])");
+    EXPECT_GT(calls, 1u);
+}
+
+TEST_F(LuaToJsonStringTest, MixedDict) {
+    lua_pushinteger(L, 1);
+    ASSERT_TRUE(doString(R""""(
+        return {
+            "Test",
+            {1, 2},
+            {a=3},
+            {},
+            1.5,
+        }
+    )""""));
+    lua_pushinteger(L, 2);
+    EXPECT_EQ(lua_to_json_string(L, -2), R""""(["Test",[1,2],{"a":3},{},1.5])"""");
+    EXPECT_EQ(lua_gettop(L), 3);
+}
+
+TEST_F(LuaToJsonStringTest, SameAsDom) {
+    ASSERT_TRUE(doString(R""""(
+        return {
+            a = {1, 2, 3},
+            b = {x = "y", [1] = true, [2] = false},
+            c = {[2] = 1, [3] = 2, [6] = 4},
+            d = {["a"] = 1, [1] = 4, [2] = 5},
+            f = {{{{}}}},
+        }
+    )""""));
+    expectSameAsDom(-1);
+    lua_getfield(L, -1, "a");
+    expectSameAsDom(-1);
+    lua_pop(L, 1);
+    lua_getfield(L, -1, "c");
+    EXPECT_EQ(lua_to_json_string(L, -1), "[null,1,2,null,null,4]");
+    lua_pop(L, 1);
+}
+
+TEST_F(LuaToJsonStringTest, FloatKey) {
+    ASSERT_TRUE(doString(R""""(
+        return {[1.5] = "float key", [2] = "int key"}
+    )""""));
+    EXPECT_EQ(json::parse(lua_to_json_string(L, -1)), json::parse(R"({"1.5":"float key","2":"int key"})"));
+    EXPECT_EQ(lua_gettop(L), 1);
+}
+
+TEST_F(LuaToJsonStringTest, EmptyArray) {
+    LuaJson_EmptyArray::Lua_Register(L);
+    lua_newtable(L);
+    LuaJson_EmptyArray{}.Lua_Push(L);
+    lua_setfield(L, -2, "empty");
+    EXPECT_EQ(lua_to_json_string(L, -1), R"({"empty":[]})");
+}
+
+TEST_F(LuaToJsonStringTest, Recursive) {
+    ASSERT_TRUE(doString(R""""(
+        x = {}
+        y = {}
+        x[1] = y
+        y["a"] = x
+        return x
+    )""""));
+    ASSERT_EQ(lua_gettop(L), 1);
+    EXPECT_RECURSIVE(lua_to_json_string(L, -1), "null");
+    EXPECT_EQ(lua_gettop(L), 1);
+}
+
+TEST_F(LuaToJsonStringTest, MaxDepth) {
+    ASSERT_TRUE(doString("return {{{1}}}"));
+    EXPECT_EQ(lua_to_json_string(L, -1, 4), "[[[1]]]");
+#ifdef USE_EXCEPTIONS
+    std::string out = "unchanged";
+    EXPECT_THROW(lua_to_json_string(L, -1, out, 3), std::runtime_error);
+    EXPECT_EQ(out, "unchanged");
+#else
+    EXPECT_EQ(lua_to_json_string(L, -1, 3), "[[null]]");
+#endif
+    EXPECT_EQ(lua_gettop(L), 1);
+}
+
+TEST_F(LuaToJsonStringTest, Cycles) {
+    ASSERT_TRUE(doString(R""""(
+        x = {a = {{}, {}}}
+        x.a[2].b = x.a[1]
+        x.a[2].c = x
+        return x
+    )""""));
+    for (auto mode: {LuaJsonCycles::Null, LuaJsonCycles::Reference}) {
+        const std::string s = lua_to_json_string(L, -1, 1000, mode);
+        EXPECT_EQ(json::parse(s), lua_to_json(L, -1, 1000, mode)) << s;
+    }
+    EXPECT_EQ(json::parse(lua_to_json_string(L, -1, 1000, LuaJsonCycles::Reference)),
+              json::parse(R""""({"a":[{},{"b":{"$ref":["a",0]},"c":{"$ref":[]}}]})""""));
+    EXPECT_RECURSIVE(lua_to_json_string(L, -1), "null");
+    EXPECT_EQ(lua_gettop(L), 1);
+}
@@ -0,0 +1,313 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "../luatestbase.hpp"
+#include "../macros.hpp"
+#include "../../luainterface.h"
+#include "../../luamethod.h"
+#include "../../luaasync.h"
+
+
+// ReSharper disable CppMemberFunctionMayBeStatic
+class LuaAsyncTester : public LuaInterface<LuaAsyncTester> {
+    friend class LuaInterface;
+
+public:
+    std::atomic<int> _started{0};
+    std::atomic<int> _ran{0};
+
+    LuaAsync<int> Twice(int a)
+    {
+        _started++;
+        return LuaAsync<int>([this, a]() {
+            _ran++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            return 2 * a;
+        });
+    }
+
+    LuaAsync<std::tuple<std::string, int>> Pair(std::string_view v) const
+    {
+        // copied, the string_view is only valid during the call
+        return LuaAsync<std::tuple<std::string, int>>([s = std::string(v)]() { return std::make_tuple(s + s, (int)s.size()); });
+    }
+
+    LuaAsync<json> Object(int a) const
+    {
+        return LuaAsync<json>([a]() { return json{{"a", a}, {"list", {1, 2}}}; });
+    }
+
+    LuaAsync<void> Nothing() const
+    {
+        return LuaAsync<void>([]() {});
+    }
+
+    LuaAsync<int> Fail(std::string_view msg) const
+    {
+        return LuaAsync<int>([msg = std::string(msg)]() -> LuaResult<int> { return LuaError(msg); });
+    }
+
+    // deeper than json_to_lua converts
+    LuaAsync<json> Deep() const
+    {
+        return LuaAsync<json>([]() {
+            json j = json::array();
+            for (int i = 0; i < 1100; i++)
+                j = json::array({std::move(j)});
+            return j;
+        });
+    }
+
+#ifdef USE_EXCEPTIONS
+    LuaAsync<int> Throw() const
+    {
+        return LuaAsync<int>([]() -> int { throw std::runtime_error("thrown"); });
+    }
+#endif
+
+    std::future<int> Future(int a) const
+    {
+        return std::async(std::launch::async, [a]() { return a + 1; });
+    }
+
+    std::future<int> Deferred(int a) const
+    {
+        return std::async(std::launch::deferred, [a]() { return a + 2; });
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "LuaAsyncTester";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(LuaAsyncTester, Twice, int),
+        LUA_METHOD(LuaAsyncTester, Pair, std::string_view),
+        LUA_METHOD(LuaAsyncTester, Object, int),
+        LUA_METHOD(LuaAsyncTester, Nothing, void),
+        LUA_METHOD(LuaAsyncTester, Fail, std::string_view),
+        LUA_METHOD(LuaAsyncTester, Deep, void),
+#ifdef USE_EXCEPTIONS
+        LUA_METHOD(LuaAsyncTester, Throw, void),
+#endif
+        LUA_METHOD(LuaAsyncTester, Future, int),
+        LUA_METHOD(LuaAsyncTester, Deferred, int),
+    });
+};
+
+class LuaAsyncTest : public LuaTestBase {
+protected:
+    LuaAsyncScheduler scheduler{L, 2};
+    LuaAsyncTester *tester;
+
+    LuaAsyncTest()
+    {
+        LuaAsyncTester::Lua_Register(L);
+        // owned by Lua, outlives the scheduler
+        tester = LuaAsyncTester::Lua_New(L);
+        lua_setglobal(L, "tester");
+    }
+
+    // runs s in a new coroutine
+    NODISCARD
+    bool spawn(const char* s)
+    {
+        if (luaL_loadstring(L, s) != LUA_OK) {
+            printf("%s\n", lua_tostring(L, -1));
+            lua_pop(L, 1);
+            return false;
+        }
+        return scheduler.Spawn();
+    }
+
+    // pumps until no coroutine waits anymore
+    void run()
+    {
+        for (int i = 0; i < 1000 && scheduler.pending() > 0; i++)
+            scheduler.Pump(std::chrono::milliseconds(10));
+        EXPECT_EQ(scheduler.pending(), 0u);
+    }
+};
+
+TEST_F(LuaAsyncTest, Results) {
+    ASSERT_TRUE(spawn(
+            "local a = tester:Twice(21)\n"
+            "local s, n = tester:Pair('ab')\n"
+            "local o = tester:Object(3)\n"
+            "local ok = tester:Nothing()\n"
+            "DONE = a == 42 and s == 'abab' and n == 2 and o.a == 3 and o.list[2] == 2 and ok == true\n"));
+    EXPECT_EQ(scheduler.pending(), 1u);
+    run();
+    lua_getglobal(L, "DONE");
+    EXPECT_TRUE(lua_toboolean(L, -1));
+    lua_pop(L, 1);
+    EXPECT_EQ(lua_gettop(L), 0);
+}
+
+TEST_F(LuaAsyncTest, Errors) {
+    ASSERT_TRUE(spawn(
+            "local v, err = tester:Fail('failed')\n"
+            "assert(v == nil and err == 'failed', err)\n"
+            "local n = tester:Twice(1)\n"
+            "DONE = n == 2\n"));
+    run();
+    lua_getglobal(L, "DONE");
+    EXPECT_TRUE(lua_toboolean(L, -1));
+    lua_pop(L, 1);
+}
+
+#ifdef USE_EXCEPTIONS
+TEST_F(LuaAsyncTest, Exception) {
+    ASSERT_TRUE(spawn(
+            "local v, err = tester:Throw()\n"
+            "DONE = v == nil and err == 'thrown'\n"));
+    run();
+    lua_getglobal(L, "DONE");
+    EXPECT_TRUE(lua_toboolean(L, -1));
+    lua_pop(L, 1);
+}
+#endif
+
+TEST_F(LuaAsyncTest, PushError) {
+    ASSERT_TRUE(doString("COUNT = 0"));
+    ASSERT_TRUE(spawn("local n = tester:Twice(1); COUNT = COUNT + n"));
+#ifdef USE_EXCEPTIONS
+    ASSERT_TRUE(spawn("local v, err = tester:Deep(); DEEP = v == nil and err == 'Max depth reached'"));
+#else
+    // the too deep part is nil
+    ASSERT_TRUE(spawn("local v = tester:Deep(); DEEP = type(v) == 'table'"));
+#endif
+    ASSERT_TRUE(spawn("local n = tester:Twice(2); COUNT = COUNT + n"));
+    run();
+    // the failed conversion is returned to its coroutine, the others are still resumed
+    lua_getglobal(L, "DEEP");
+    EXPECT_TRUE(lua_toboolean(L, -1));
+    lua_getglobal(L, "COUNT");
+    EXPECT_EQ(lua_tointeger(L, -1), 6);
+    lua_pop(L, 2);
+    EXPECT_EQ(lua_gettop(L), 0);
+}
+
+TEST_F(LuaAsyncTest, Future) {
+    ASSERT_TRUE(spawn("DONE = tester:Future(1) + tester:Deferred(1) == 5"));
+    run();
+    lua_getglobal(L, "DONE");
+    EXPECT_TRUE(lua_toboolean(L, -1));
+    lua_pop(L, 1);
+}
+
+TEST_F(LuaAsyncTest, Concurrent) {
+    ASSERT_TRUE(doString("SUM = 0"));
+    constexpr int count = 100;
+    for (int i = 1; i <= count; i++) {
+        lua_pushinteger(L, i);
+        lua_setglobal(L, "I");
+        // SUM is only read after both calls, other coroutines run while this one waits
+        ASSERT_TRUE(spawn("local i = I; local a = tester:Twice(i); local b = tester:Twice(i); SUM = SUM + a + b"));
+    }
+    // all started before any result is ready
+    EXPECT_EQ(tester->_started, count);
+    EXPECT_EQ(scheduler.pending(), (size_t)count);
+    run();
+    EXPECT_EQ(tester->_started, 2 * count);
+    EXPECT_EQ(tester->_ran, 2 * count);
+    lua_getglobal(L, "SUM");
+    EXPECT_EQ(lua_tointeger(L, -1), 2 * count * (count + 1));
+    lua_pop(L, 1);
+}
+
+TEST_F(LuaAsyncTest, OutsideCoroutine) {
+    EXPECT_FALSE(doString("tester:Twice(1)"));
+    EXPECT_NE(std::string(lua_tostring(L, -1)).find("attempt to yield from outside a coroutine"), std::string::npos);
+    lua_pop(L, 1);
+    // the work is not started
+    EXPECT_EQ(tester->_started, 1);
+    EXPECT_EQ(tester->_ran, 0);
+    EXPECT_EQ(scheduler.pending(), 0u);
+}
+
+TEST_F(LuaAsyncTest, ResumeError) {
+    std::string error;
+    scheduler.SetErrorHandler([&error](lua_State *, const char *msg) { error = msg; });
+    ASSERT_TRUE(spawn("tester:Twice(1); error('after resume')"));
+    run();
+    EXPECT_NE(error.find("after resume"), std::string::npos);
+}
+
+TEST_F(LuaAsyncTest, NoScheduler) {
+    lua_State *L2 = luaL_newstate();
+    luaL_requiref(L2, LUA_GNAME, luaopen_base, 1);
+    lua_pop(L2, 1);
+    LuaAsyncTester::Lua_Register(L2);
+    LuaAsyncTester::Lua_New(L2);
+    lua_setglobal(L2, "tester");
+    lua_State *co = lua_newthread(L2);
+    ASSERT_EQ(luaL_loadstring(co, "return tester:Twice(1)"), LUA_OK);
+    int nres = 0;
+    EXPECT_NE(lua_resume(co, L2, 0, &nres), LUA_YIELD);
+    EXPECT_NE(std::string(lua_tostring(co, -1)).find("no LuaAsyncScheduler"), std::string::npos);
+    lua_close(L2);
+}
+
+TEST(LuaAsyncSchedulerTest, InlineExecutor) {
+    lua_State *L = luaL_newstate();
+    luaL_requiref(L, LUA_GNAME, luaopen_base, 1);
+    lua_pop(L, 1);
+    {
+        int posted = 0;
+        LuaAsyncScheduler scheduler(L, [&posted](std::function<void()> work) {
+            posted++;
+            work();
+        });
+        EXPECT_EQ(LuaAsyncScheduler::Get(L), &scheduler);
+        LuaAsyncTester::Lua_Register(L);
+        LuaAsyncTester::Lua_New(L);
+        lua_setglobal(L, "tester");
+        ASSERT_EQ(luaL_loadstring(L, "local s = tester:Pair('x'); DONE = s"), LUA_OK);
+        EXPECT_TRUE(scheduler.Spawn());
+        EXPECT_EQ(posted, 1);
+        // resumed on the next pump only
+        EXPECT_EQ(scheduler.pending(), 1u);
+        EXPECT_EQ(scheduler.Pump(), 1);
+        EXPECT_EQ(scheduler.pending(), 0u);
+        lua_getglobal(L, "DONE");
+        EXPECT_STREQ(lua_tostring(L, -1), "xx");
+        lua_pop(L, 1);
+    }
+    EXPECT_EQ(LuaAsyncScheduler::Get(L), nullptr);
+    lua_close(L);
+}
+
+#ifdef USE_EXCEPTIONS
+TEST(LuaAsyncSchedulerTest, ExecutorThrows) {
+    lua_State *L = luaL_newstate();
+    luaL_requiref(L, LUA_GNAME, luaopen_base, 1);
+    lua_pop(L, 1);
+    {
+        LuaAsyncScheduler scheduler(L, [](std::function<void()>) { throw std::runtime_error("queue full"); });
+        LuaAsyncTester::Lua_Register(L);
+        LuaAsyncTester::Lua_New(L);
+        lua_setglobal(L, "tester");
+        ASSERT_EQ(luaL_loadstring(L, "local ok, err = pcall(tester.Twice, tester, 1); DONE = not ok and err"), LUA_OK);
+        EXPECT_TRUE(scheduler.Spawn());
+        // the call raised the error instead of waiting forever
+        EXPECT_EQ(scheduler.pending(), 0u);
+        lua_getglobal(L, "DONE");
+        EXPECT_STREQ(lua_tostring(L, -1), "queue full");
+        lua_pop(L, 1);
+    }
+    lua_close(L);
+}
+#endif
+
+TEST(LuaAsyncSchedulerTest, ThreadPool) {
+    std::atomic<int> sum{0};
+    {
+        LuaThreadPool pool(3);
+        EXPECT_EQ(pool.size(), 3u);
+        for (int i = 1; i <= 100; i++)
+            pool.Post([&sum, i]() { sum += i; });
+    }
+    // destructor runs all posted work
+    EXPECT_EQ(sum, 5050);
+}
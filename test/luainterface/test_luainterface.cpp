@@ -0,0 +1,528 @@
+#include "../luatestbase.hpp"
+#include "../macros.hpp"
+#include "../../luainterface.h"
+#include "../../luamethod.h"
+
+
+// compile time lookup
+static constexpr auto testMap = LuaGlue::make_constexpr_map<int>({
+    {"a", 1},
+    {"b", 2},
+    {"Long Name", 3},
+    {"", 4},
+});
+static_assert(testMap.size() == 4, "wrong size");
+static_assert(testMap.find("a")->second == 1, "wrong value for a");
+static_assert(testMap.find("b")->second == 2, "wrong value for b");
+static_assert(testMap.find("Long Name")->second == 3, "wrong value for Long Name");
+static_assert(testMap.find("")->second == 4, "wrong value for empty key");
+static_assert(testMap.find("c") == testMap.end(), "c should not be found");
+static_assert(testMap.find("Long") == testMap.end(), "Long should not be found");
+
+// duplicate keys are a compile error in constant evaluation, and fail at runtime
+TEST(ConstexprMapTest, DuplicateKey) {
+    const std::pair<std::string_view, int> entries[] = {{"a", 1}, {"b", 2}, {"a", 3}};
+#ifdef USE_EXCEPTIONS
+    EXPECT_THROW(LuaGlue::make_constexpr_map<int>(entries), std::logic_error);
+#else
+    EXPECT_DEATH(LuaGlue::make_constexpr_map<int>(entries), "duplicate key");
+#endif
+}
+
+
+// ReSharper disable CppMemberFunctionMayBeStatic
+class LuaInterfaceTester : public LuaInterface<LuaInterfaceTester> {
+    friend class LuaInterface;
+
+    int Add(int a, int b) const
+    {
+        return a + b;
+    }
+
+    std::string Name() const
+    {
+        return "tester";
+    }
+
+    int _value = 0;
+
+    void SetValue(int value)
+    {
+        _value = value;
+    }
+
+    int GetValue() const
+    {
+        return _value;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "LuaInterfaceTester";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(LuaInterfaceTester, Add, int, int),
+        LUA_METHOD(LuaInterfaceTester, Name, void),
+        LUA_METHOD(LuaInterfaceTester, SetValue, int),
+        LUA_METHOD(LuaInterfaceTester, GetValue, void),
+    });
+
+    int Lua_Index(lua_State *L, const char *key) override
+    {
+        if (strcmp(key, "value") == 0) {
+            lua_pushinteger(L, _value);
+            return 1;
+        }
+        return 0;
+    }
+
+    bool Lua_NewIndex(lua_State *L, const char *key) override
+    {
+        if (strcmp(key, "value") == 0) {
+            _value = static_cast<int>(luaL_checkinteger(L, -1));
+            return true;
+        }
+        return false;
+    }
+};
+
+// class without Lua_Index, so IndexMode::MethodTable can use the table as __index directly
+class LuaInterfaceMethodsOnlyTester : public LuaInterface<LuaInterfaceMethodsOnlyTester> {
+    friend class LuaInterface;
+
+    int Get() const
+    {
+        return 42;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "LuaInterfaceMethodsOnlyTester";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(LuaInterfaceMethodsOnlyTester, Get, void),
+    });
+};
+
+static_assert(LuaInterface<LuaInterfaceTester>::HasCustomIndex(), "Lua_Index override not detected");
+static_assert(!LuaInterface<LuaInterfaceMethodsOnlyTester>::HasCustomIndex(), "Lua_Index override misdetected");
+
+using IndexMode = LuaInterface<LuaInterfaceTester>::IndexMode;
+
+class LuaInterfaceTest : public LuaTestBase, public testing::WithParamInterface<IndexMode> {
+protected:
+    LuaInterfaceTester tester;
+    LuaInterfaceMethodsOnlyTester methodsOnlyTester;
+
+    LuaInterfaceTest()
+    {
+        LuaInterfaceTester::Lua_Register(L, GetParam());
+        tester.Lua_Push(L);
+        lua_setglobal(L, "tester");
+        LuaInterfaceMethodsOnlyTester::Lua_Register(L,
+                static_cast<LuaInterface<LuaInterfaceMethodsOnlyTester>::IndexMode>(GetParam()));
+        methodsOnlyTester.Lua_Push(L);
+        lua_setglobal(L, "methodsOnlyTester");
+    }
+
+    ~LuaInterfaceTest() override
+    {
+        lua_pushnil(L);
+        lua_setglobal(L, "tester");
+        lua_pushnil(L);
+        lua_setglobal(L, "methodsOnlyTester");
+        lua_gc(L, LUA_GCCOLLECT, 0);
+    }
+};
+
+TEST_P(LuaInterfaceTest, Methods) {
+    ASSERT_TRUE(doString(R""""(
+        tester:SetValue(tester:Add(1, 2))
+        return tester:Name() == "tester" and tester:GetValue() == 3
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+TEST_P(LuaInterfaceTest, MethodsOnly) {
+    ASSERT_TRUE(doString(R""""(
+        return methodsOnlyTester:Get() == 42 and methodsOnlyTester.unknown == nil
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+TEST_P(LuaInterfaceTest, Properties) {
+    ASSERT_TRUE(doString(R""""(
+        tester.value = 5
+        return tester.value == 5 and tester:GetValue() == 5 and tester.unknown == nil
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+TEST_P(LuaInterfaceTest, AssignToMethod) {
+    ASSERT_TRUE(doString(R""""(
+        local ok, err = pcall(function() tester.Add = 1 end)
+        return not ok and err:match("Can't assign to method \"Add\"") ~= nil
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+TEST_P(LuaInterfaceTest, AssignUnknown) {
+    ASSERT_TRUE(doString(R""""(
+        local ok, err = pcall(function() tester.unknown = 1 end)
+        return not ok and err:match("Unknown property \"unknown\"") ~= nil
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+TEST_P(LuaInterfaceTest, TestThis) {
+    const int top = lua_gettop(L);
+    tester.Lua_Push(L);
+    methodsOnlyTester.Lua_Push(L);
+    lua_pushinteger(L, 1);
+    lua_newtable(L);
+    EXPECT_EQ(LuaInterfaceTester::luaL_testthis(L, top + 1), &tester);
+    EXPECT_EQ(LuaInterfaceTester::luaL_testthis(L, -4), &tester);
+    EXPECT_EQ(LuaInterfaceTester::luaL_testthis(L, -3), nullptr);
+    EXPECT_EQ(LuaInterfaceMethodsOnlyTester::luaL_testthis(L, -3), &methodsOnlyTester);
+    EXPECT_EQ(LuaInterfaceTester::luaL_testthis(L, -2), nullptr);
+    EXPECT_EQ(LuaInterfaceTester::luaL_testthis(L, -1), nullptr);
+    EXPECT_EQ(lua_gettop(L), top + 4);
+    lua_settop(L, top); // don't run __gc on destroyed testers
+}
+
+TEST_P(LuaInterfaceTest, TestThisForeignUserdata) {
+    // userdata with the right metatable that was not created by Lua_Push
+    const int top = lua_gettop(L);
+    auto ud = static_cast<LuaInterfaceTester **>(lua_newuserdata(L, sizeof(LuaInterfaceTester *)));
+    *ud = &tester;
+    luaL_setmetatable(L, "LuaInterfaceTester");
+    EXPECT_EQ(LuaInterfaceTester::luaL_testthis(L, -1), &tester);
+    EXPECT_EQ(LuaInterfaceTester::luaL_checkthis(L, -1), &tester);
+    EXPECT_EQ(LuaInterfaceMethodsOnlyTester::luaL_testthis(L, -1), nullptr);
+    EXPECT_EQ(lua_gettop(L), top + 1);
+    lua_settop(L, top);
+}
+
+TEST_P(LuaInterfaceTest, WrongSelf) {
+    ASSERT_TRUE(doString(R""""(
+        local ok, err = pcall(tester.Add, methodsOnlyTester, 1, 2)
+        return not ok and err:match("LuaInterfaceTester expected") ~= nil
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+// class with instance cache
+class LuaInterfaceCachedTester : public LuaInterface<LuaInterfaceCachedTester> {
+    friend class LuaInterface;
+
+    int Get() const
+    {
+        return 1;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "LuaInterfaceCachedTester";
+    static constexpr bool Lua_CacheInstances = true;
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(LuaInterfaceCachedTester, Get, void),
+    });
+};
+
+TEST_P(LuaInterfaceTest, NotCached) {
+    tester.Lua_Push(L);
+    tester.Lua_Push(L);
+    EXPECT_FALSE(lua_rawequal(L, -1, -2));
+    lua_pop(L, 2);
+}
+
+TEST_P(LuaInterfaceTest, Cached) {
+    LuaInterfaceCachedTester cachedTester;
+    LuaInterfaceCachedTester::Lua_Register(L,
+            static_cast<LuaInterface<LuaInterfaceCachedTester>::IndexMode>(GetParam()));
+    cachedTester.Lua_Push(L);
+    lua_setglobal(L, "a");
+    cachedTester.Lua_Push(L);
+    lua_setglobal(L, "b");
+    EXPECT_EQ(lua_gettop(L), 0);
+    ASSERT_TRUE(doString(R""""(
+        return a == b and rawequal(a, b) and a:Get() == 1
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+    lua_pop(L, 1);
+
+    // evicted instance gets a new userdata
+    LuaInterfaceCachedTester::Lua_Evict(L, &cachedTester);
+    cachedTester.Lua_Push(L);
+    lua_getglobal(L, "a");
+    EXPECT_FALSE(lua_rawequal(L, -1, -2));
+    EXPECT_EQ(LuaInterfaceCachedTester::luaL_testthis(L, -1), &cachedTester);
+    EXPECT_EQ(LuaInterfaceCachedTester::luaL_testthis(L, -2), &cachedTester);
+    lua_pop(L, 2);
+
+    // cache does not keep the userdata alive
+    cachedTester.Lua_Push(L);
+    lua_setglobal(L, "a");
+    ASSERT_TRUE(doString(R""""(
+        local t = setmetatable({}, {__mode = "k"})
+        t[a] = true
+        a = nil
+        b = nil
+        collectgarbage()
+        collectgarbage()
+        return next(t) == nil
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+    lua_pop(L, 1);
+    cachedTester.Lua_Push(L);
+    EXPECT_EQ(LuaInterfaceCachedTester::luaL_testthis(L, -1), &cachedTester);
+    lua_pop(L, 1);
+    lua_gc(L, LUA_GCCOLLECT, 0);
+}
+
+// value type that is created inside Lua memory
+class LuaInterfaceValueTester : public LuaInterface<LuaInterfaceValueTester> {
+    friend class LuaInterface;
+
+public:
+    static int destroyed;
+
+    LuaInterfaceValueTester(int x, int y)
+        : _x(x), _y(y)
+    {
+    }
+
+    ~LuaInterfaceValueTester() override
+    {
+        destroyed++;
+    }
+
+    static int Create(lua_State *L)
+    {
+        Lua_New(L, static_cast<int>(luaL_checkinteger(L, 1)), static_cast<int>(luaL_checkinteger(L, 2)));
+        return 1;
+    }
+
+private:
+    alignas(32) int _x; // over-aligned to test placement
+    int _y;
+
+    int Sum() const
+    {
+        return _x + _y;
+    }
+
+    const LuaInterfaceValueTester* Self() const
+    {
+        return this;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "LuaInterfaceValueTester";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(LuaInterfaceValueTester, Sum, void),
+        LUA_METHOD(LuaInterfaceValueTester, Self, void),
+    });
+};
+
+int LuaInterfaceValueTester::destroyed = 0;
+
+TEST_P(LuaInterfaceTest, ValueOwned) {
+    LuaInterfaceValueTester::destroyed = 0;
+    LuaInterfaceValueTester::Lua_Register(L,
+            static_cast<LuaInterface<LuaInterfaceValueTester>::IndexMode>(GetParam()));
+    const LuaInterfaceValueTester *o = LuaInterfaceValueTester::Lua_New(L, 1, 2);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(o) % alignof(LuaInterfaceValueTester), 0u);
+    EXPECT_EQ(LuaInterfaceValueTester::luaL_testthis(L, -1), o);
+    EXPECT_EQ(LuaInterfaceTester::luaL_testthis(L, -1), nullptr);
+    lua_setglobal(L, "value");
+    lua_register(L, "Value", LuaInterfaceValueTester::Create);
+    ASSERT_TRUE(doString(R""""(
+        local values = {}
+        for i = 1, 10 do
+            values[i] = Value(i, 1)
+        end
+        for i = 1, 10 do
+            if values[i]:Sum() ~= i + 1 then
+                return false
+            end
+        end
+        return value:Sum() == 3
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+    lua_pop(L, 1);
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    EXPECT_EQ(LuaInterfaceValueTester::destroyed, 10);
+    lua_pushnil(L);
+    lua_setglobal(L, "value");
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    EXPECT_EQ(LuaInterfaceValueTester::destroyed, 11);
+}
+
+TEST_P(LuaInterfaceTest, ValueOwnedPushedAgain) {
+    LuaInterfaceValueTester::destroyed = 0;
+    LuaInterfaceValueTester::Lua_Register(L,
+            static_cast<LuaInterface<LuaInterfaceValueTester>::IndexMode>(GetParam()));
+    lua_register(L, "Value", LuaInterfaceValueTester::Create);
+    // pushing an owned instance again returns the owning userdata, which keeps it alive
+    ASSERT_TRUE(doString(R""""(
+        local a = Value(2, 3)
+        b = a:Self()
+        assert(rawequal(a, b))
+        a = nil
+        collectgarbage()
+        collectgarbage()
+    )""""));
+    EXPECT_EQ(LuaInterfaceValueTester::destroyed, 0);
+    ASSERT_TRUE(doString("return b:Sum() == 5"));
+    EXPECT_TRUE(lua_toboolean(L, -1));
+    lua_pop(L, 1);
+    ASSERT_TRUE(doString("b = nil; collectgarbage(); collectgarbage()"));
+    EXPECT_EQ(LuaInterfaceValueTester::destroyed, 1);
+}
+
+// class with declarative properties
+class LuaInterfacePropertyTester : public LuaInterface<LuaInterfacePropertyTester> {
+    friend class LuaInterface;
+
+public:
+    int count = 1;
+    std::string label = "label";
+    double ratio = 0.5;
+    float scale = 2.f;
+    bool enabled = false;
+    int id = 7;
+
+private:
+    int _level = 3;
+
+    int GetLevel() const
+    {
+        return _level;
+    }
+
+    void SetLevel(int level)
+    {
+        _level = level > 10 ? 10 : level;
+    }
+
+    std::string Kind() const
+    {
+        return "kind";
+    }
+
+    int Get() const
+    {
+        return count;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "LuaInterfacePropertyTester";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(LuaInterfacePropertyTester, Get, void),
+    });
+    static constexpr auto Lua_Properties = MakePropertyMap({
+        LUA_PROPERTY(LuaInterfacePropertyTester, count),
+        LUA_PROPERTY(LuaInterfacePropertyTester, label),
+        LUA_PROPERTY(LuaInterfacePropertyTester, ratio),
+        LUA_PROPERTY(LuaInterfacePropertyTester, scale),
+        LUA_PROPERTY(LuaInterfacePropertyTester, enabled),
+        LUA_PROPERTY_READONLY(LuaInterfacePropertyTester, id),
+        LUA_PROPERTY_GETSET(LuaInterfacePropertyTester, level, GetLevel, SetLevel, int),
+        LUA_PROPERTY_GET(LuaInterfacePropertyTester, kind, Kind),
+    });
+
+    int Lua_Index(lua_State *L, const char *key) override
+    {
+        if (strcmp(key, "dynamic") == 0) {
+            lua_pushinteger(L, 99);
+            return 1;
+        }
+        return 0;
+    }
+};
+
+static_assert(LuaInterface<LuaInterfacePropertyTester>::HasCustomIndex(), "properties need an __index fallback");
+
+class LuaInterfacePropertyTest : public LuaInterfaceTest {
+protected:
+    LuaInterfacePropertyTester propertyTester;
+
+    LuaInterfacePropertyTest()
+    {
+        LuaInterfacePropertyTester::Lua_Register(L,
+                static_cast<LuaInterface<LuaInterfacePropertyTester>::IndexMode>(GetParam()));
+        propertyTester.Lua_Push(L);
+        lua_setglobal(L, "propertyTester");
+    }
+
+    ~LuaInterfacePropertyTest() override
+    {
+        lua_pushnil(L);
+        lua_setglobal(L, "propertyTester");
+        lua_gc(L, LUA_GCCOLLECT, 0);
+    }
+};
+
+TEST_P(LuaInterfacePropertyTest, Read) {
+    ASSERT_TRUE(doString(R""""(
+        local t = propertyTester
+        return t.count == 1 and t.label == "label" and t.ratio == 0.5 and t.scale == 2 and t.enabled == false
+                and t.id == 7 and t.level == 3 and t.kind == "kind" and t.dynamic == 99 and t.unknown == nil
+                and t:Get() == 1
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+TEST_P(LuaInterfacePropertyTest, Write) {
+    ASSERT_TRUE(doString(R""""(
+        local t = propertyTester
+        t.count = 5
+        t.label = "new label"
+        t.ratio = 1.25
+        t.scale = 0.5
+        t.enabled = true
+        t.level = 20
+        return t.count == 5 and t:Get() == 5 and t.label == "new label" and t.ratio == 1.25 and t.enabled
+                and t.level == 10
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+    EXPECT_EQ(propertyTester.count, 5);
+    EXPECT_EQ(propertyTester.label, "new label");
+    EXPECT_EQ(propertyTester.ratio, 1.25);
+    EXPECT_EQ(propertyTester.scale, 0.5f);
+    EXPECT_TRUE(propertyTester.enabled);
+}
+
+TEST_P(LuaInterfacePropertyTest, WriteReadOnly) {
+    ASSERT_TRUE(doString(R""""(
+        local ok1, err1 = pcall(function() propertyTester.id = 1 end)
+        local ok2, err2 = pcall(function() propertyTester.kind = "other" end)
+        return not ok1 and err1:match("Can't assign to read%-only property \"id\"") ~= nil
+                and not ok2 and err2:match("Can't assign to read%-only property \"kind\"") ~= nil
+                and propertyTester.id == 7
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+    EXPECT_EQ(propertyTester.id, 7);
+}
+
+TEST_P(LuaInterfacePropertyTest, WriteWrongType) {
+    ASSERT_TRUE(doString(R""""(
+        local ok, err = pcall(function() propertyTester.count = "x" end)
+        return not ok and propertyTester.count == 1
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+INSTANTIATE_TEST_SUITE_P(IndexModes, LuaInterfaceTest,
+        testing::Values(IndexMode::Function, IndexMode::MethodTable));
+INSTANTIATE_TEST_SUITE_P(IndexModes, LuaInterfacePropertyTest,
+        testing::Values(IndexMode::Function, IndexMode::MethodTable));
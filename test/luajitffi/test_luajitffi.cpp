@@ -0,0 +1,189 @@
+#include <cstdint>
+#include "../luatestbase.hpp"
+#include "../macros.hpp"
+#include "../../luainterface.h"
+#include "../../luamethod.h"
+#include "../../luajitffi.h"
+
+
+// ReSharper disable CppMemberFunctionMayBeStatic
+class LuaJitFFITester : public LuaInterface<LuaJitFFITester> {
+    friend class LuaInterface;
+
+public:
+    int _value = 0;
+
+    int Add(int a, int b) const
+    {
+        return a + b;
+    }
+
+    void SetValue(int value)
+    {
+        _value = value;
+    }
+
+    int GetValue() const
+    {
+        return _value;
+    }
+
+    double Scale(double f) const
+    {
+        return _value * f;
+    }
+
+    bool IsPositive() const
+    {
+        return _value > 0;
+    }
+
+    int64_t Big() const
+    {
+        return (int64_t)1 << 40;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "LuaJitFFITester";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(LuaJitFFITester, Add, int, int),
+        LUA_METHOD(LuaJitFFITester, SetValue, int),
+        LUA_METHOD(LuaJitFFITester, GetValue, void),
+        LUA_METHOD(LuaJitFFITester, Scale, double),
+        LUA_METHOD(LuaJitFFITester, IsPositive, void),
+        LUA_METHOD(LuaJitFFITester, Big, void),
+    });
+};
+
+// with Lua_Index, the method table is wrapped in a Lua function for IndexMode::MethodTable
+class LuaJitFFIIndexTester : public LuaInterface<LuaJitFFIIndexTester> {
+    friend class LuaInterface;
+
+public:
+    int Twice(int a) const
+    {
+        return 2 * a;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "LuaJitFFIIndexTester";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(LuaJitFFIIndexTester, Twice, int),
+    });
+
+    int Lua_Index(lua_State *L, const char *key) override
+    {
+        if (strcmp(key, "value") == 0) {
+            lua_pushinteger(L, 3);
+            return 1;
+        }
+        return 0;
+    }
+};
+
+class LuaJitFFITest : public LuaTestBase {
+protected:
+    LuaJitFFITest()
+    {
+        // ffi is only preloaded by luaL_openlibs
+        luaL_openlibs(L);
+    }
+
+    bool setMethods() const
+    {
+        return LuaGlue::setffimethods<LuaJitFFITester>(L, {
+            LUA_FFI_METHOD(LuaJitFFITester, Add),
+            LUA_FFI_METHOD(LuaJitFFITester, SetValue),
+            LUA_FFI_METHOD(LuaJitFFITester, GetValue),
+            LUA_FFI_METHOD(LuaJitFFITester, Scale),
+            LUA_FFI_METHOD(LuaJitFFITester, IsPositive),
+            LUA_FFI_METHOD(LuaJitFFITester, Big),
+        });
+    }
+};
+
+TEST(LuaJitFFIEntryTest, CType) {
+    EXPECT_EQ(LUA_FFI_METHOD(LuaJitFFITester, Add).ctype, "int (*)(void*, int, int)");
+    EXPECT_EQ(LUA_FFI_METHOD(LuaJitFFITester, SetValue).ctype, "void (*)(void*, int)");
+    EXPECT_EQ(LUA_FFI_METHOD(LuaJitFFITester, IsPositive).ctype, "bool (*)(void*)");
+    EXPECT_EQ(LUA_FFI_METHOD(LuaJitFFITester, Big).ctype, "int64_t (*)(void*)");
+    EXPECT_EQ(LUA_FFI_METHOD(LuaJitFFITester, Scale).name, "Scale");
+    EXPECT_EQ(LUA_FFI_METHOD(LuaJitFFITester, Scale).nargs, 1);
+}
+
+TEST(LuaJitFFIEntryTest, Trampoline) {
+    LuaJitFFITester o;
+    LuaJitFFITester* ud[] = {&o, nullptr};
+    auto set = reinterpret_cast<void (*)(void*, int)>(LUA_FFI_METHOD(LuaJitFFITester, SetValue).func);
+    auto get = reinterpret_cast<int (*)(void*)>(LUA_FFI_METHOD(LuaJitFFITester, GetValue).func);
+    set(ud, 5);
+    EXPECT_EQ(o._value, 5);
+    EXPECT_EQ(get(ud), 5);
+    EXPECT_EQ(get(ud + 1), 0); // destroyed object
+}
+
+TEST_F(LuaJitFFITest, RequiresMethodTable) {
+    LuaJitFFITester::Lua_Register(L);
+    EXPECT_FALSE(setMethods());
+    EXPECT_EQ(lua_gettop(L), 0);
+}
+
+TEST_F(LuaJitFFITest, Calls) {
+    LuaJitFFITester::Lua_Register(L, LuaJitFFITester::IndexMode::MethodTable);
+#ifdef LUACOMPAT_LUAJIT
+    EXPECT_TRUE(setMethods());
+#else
+    EXPECT_FALSE(setMethods());
+#endif
+    EXPECT_EQ(lua_gettop(L), 0);
+    // owned by Lua, so it outlives the calls in any case
+    LuaJitFFITester *o = LuaJitFFITester::Lua_New(L);
+    lua_setglobal(L, "o");
+    // loop to get the calls compiled by LuaJIT
+    ASSERT_TRUE(doString(
+            "local sum = 0\n"
+            "for i = 1, 1000 do o:SetValue(i); sum = sum + o:GetValue() + o:Add(i, 1) end\n"
+            "assert(sum == 1002000, sum)\n"
+            "assert(o:Scale(0.5) == 500)\n"
+            "assert(o:IsPositive() == true)\n"
+            "o:SetValue(-1)\n"
+            "assert(o:IsPositive() == false)\n"));
+    EXPECT_EQ(o->_value, -1);
+#ifdef LUACOMPAT_LUAJIT
+    lua_getglobal(L, "o");
+    lua_getfield(L, -1, "GetValue");
+    EXPECT_TRUE(lua_isfunction(L, -1));
+    EXPECT_FALSE(lua_iscfunction(L, -1));
+    lua_pop(L, 2);
+    // 64bit integers are returned as cdata
+    ASSERT_TRUE(doString("assert(o:Big() == 2^40 and type(o:Big()) == 'cdata')"));
+#else
+    ASSERT_TRUE(doString("assert(o:Big() == 2^40)"));
+#endif
+}
+
+TEST_F(LuaJitFFITest, CustomIndex) {
+    LuaJitFFIIndexTester::Lua_Register(L, LuaJitFFIIndexTester::IndexMode::MethodTable);
+#ifdef LUACOMPAT_LUAJIT
+    EXPECT_TRUE(LuaGlue::setffimethods<LuaJitFFIIndexTester>(L, {LUA_FFI_METHOD(LuaJitFFIIndexTester, Twice)}));
+#endif
+    EXPECT_EQ(lua_gettop(L), 0);
+    LuaJitFFIIndexTester::Lua_New(L);
+    lua_setglobal(L, "o");
+    ASSERT_TRUE(doString("assert(o:Twice(o.value) == 6)"));
+#ifdef LUACOMPAT_LUAJIT
+    ASSERT_TRUE(doString("assert(debug.getinfo(o.Twice, 'S').what == 'Lua')"));
+#endif
+}
+
+TEST_F(LuaJitFFITest, BadSelf) {
+    LuaJitFFITester::Lua_Register(L, LuaJitFFITester::IndexMode::MethodTable);
+    (void)setMethods();
+    LuaJitFFITester::Lua_New(L);
+    lua_setglobal(L, "o");
+    ASSERT_TRUE(doString(
+            "local ok, err = pcall(o.GetValue, {})\n"
+            "assert(not ok and err:find('LuaJitFFITester expected, got table'), err)\n"
+            "ok, err = pcall(o.GetValue, io.stdout)\n"
+            "assert(not ok and err:find('LuaJitFFITester expected'), err)\n"));
+}
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <iterator>
 #include "../luatestbase.hpp"
 #include "../macros.hpp"
 #include "../../luainterface.h"
@@ -5,9 +7,31 @@
 
 
 // ReSharper disable CppMemberFunctionMayBeStatic
+static int add(int a, int b)
+{
+    return a + b;
+}
+
+static std::pair<std::string, int64_t> describe(std::string_view s)
+{
+    return {std::string(s) + "!", static_cast<int64_t>(s.size())};
+}
+
 class LuaMethodTester : public LuaInterface<LuaMethodTester> {
     friend class LuaInterface;
 
+public:
+    static int Twice(int a)
+    {
+        return 2 * a;
+    }
+
+    static void Nothing()
+    {
+    }
+
+private:
+
     void RecursiveArgTester(json&) const
     {
     }
@@ -17,6 +41,147 @@ class LuaMethodTester : public LuaInterface<LuaMethodTester> {
         return json::parse(std::string(2000, '[') + std::string(2000, ']'));
     }
 
+    std::string StringViewTester(std::string_view s) const
+    {
+        return std::string(s) + "!";
+    }
+
+    std::string_view StringViewResultTester() const
+    {
+        return {"a\0b", 3};
+    }
+
+    LuaVariant VariantTester(LuaVariant v) const
+    {
+        return v;
+    }
+
+    LuaResult<int> Checked(int v) const
+    {
+        if (v < 0)
+            return LuaError("negative value " + std::to_string(v));
+        return v * 2;
+    }
+
+    LuaResult<std::pair<int, std::string>> CheckedPair(int v) const
+    {
+        if (v < 0)
+            return LuaError("negative");
+        return std::make_pair(v, std::string("ok"));
+    }
+
+    LuaResult<void> CheckedVoid(bool ok) const
+    {
+        if (!ok)
+            return LuaError("failed");
+        return {};
+    }
+
+    int VariantThenInt(LuaVariant, int i) const
+    {
+        return i;
+    }
+
+    LuaResult<std::string> Join(const char* sep, LuaVarArgs args) const
+    {
+        // res is alive, so the argument checks must not raise
+        std::string res;
+        for (const auto arg : args) {
+            const auto s = arg.tryStringView();
+            if (!s)
+                return LuaError(s.error());
+            if (!res.empty())
+                res += sep;
+            res += s.value();
+        }
+        return res;
+    }
+
+    std::tuple<int, int, std::string> Describe(LuaVarArgs args) const
+    {
+        const auto variants = args.toVariants();
+        return {(int)args.size(), args.empty() ? LUA_TNONE : args[0].type(),
+                variants.empty() ? "" : variants.back().toString()};
+    }
+
+    std::string Log(int level)
+    {
+        return "level " + std::to_string(level);
+    }
+
+    std::string Log(const char* fmt, LuaVarArgs args)
+    {
+        return std::string(fmt) + " with " + std::to_string(args.size());
+    }
+
+    std::string Set(const char* name)
+    {
+        return std::string("Set(") + name + ")";
+    }
+
+    std::string Set(const char* name, int value)
+    {
+        return std::string("Set(") + name + ", int " + std::to_string(value) + ")";
+    }
+
+    std::string Set(const char* name, const char* value) const
+    {
+        return std::string("Set(") + name + ", string " + value + ")";
+    }
+
+    std::string Set(const char* name, bool value)
+    {
+        return std::string("Set(") + name + ", bool " + (value ? "true" : "false") + ")";
+    }
+
+    std::string Set(const char* name, LuaVariant)
+    {
+        return std::string("Set(") + name + ", any)";
+    }
+
+    // calling thread
+    std::string Where(lua_State *L, const char* tag) const
+    {
+        const bool isMain = lua_pushthread(L) == 1;
+        lua_pop(L, 1);
+        return std::string(tag) + (isMain ? " main" : " coroutine");
+    }
+
+    std::string Where(lua_State *L, int n) const
+    {
+        return Where(L, std::to_string(n).c_str());
+    }
+
+    LuaYield YieldPair(Lua& lua, int a) const
+    {
+        lua.Push(a);
+        lua.Push(a + 1);
+        return LuaYield(2);
+    }
+
+public:
+    lua_State *_waiting = nullptr;
+    int _waitId = 0;
+
+private:
+    // resumed by the test
+    LuaYield Wait(lua_State *L, int id)
+    {
+        _waiting = L;
+        _waitId = id;
+        return LuaYield();
+    }
+
+    std::pair<int, int> PairTester() const
+    {
+        return {1, 2};
+    }
+
+    std::tuple<int64_t, double, std::string, bool, json> TupleTester() const
+    {
+        return {3, 0.5, "four", true, json::parse(R"({"a": 5})")};
+    }
+
 protected: // Lua interface implementation
     static constexpr char Lua_Name[] = "LuaMethodTester";
     static const MethodMap Lua_Methods;
@@ -25,6 +190,25 @@ protected: // Lua interface implementation
 const LuaInterface<LuaMethodTester>::MethodMap LuaMethodTester::Lua_Methods = {
     LUA_METHOD(LuaMethodTester, RecursiveArgTester, json),
     LUA_METHOD(LuaMethodTester, TooDeepResultTester, void),
+    LUA_METHOD(LuaMethodTester, StringViewTester, std::string_view),
+    LUA_METHOD(LuaMethodTester, StringViewResultTester, void),
+    LUA_METHOD(LuaMethodTester, VariantTester, LuaVariant),
+    LUA_METHOD(LuaMethodTester, PairTester, void),
+    LUA_METHOD(LuaMethodTester, Checked, int),
+    LUA_METHOD(LuaMethodTester, CheckedPair, int),
+    LUA_METHOD(LuaMethodTester, CheckedVoid, bool),
+    LUA_METHOD(LuaMethodTester, VariantThenInt, LuaVariant, int),
+    LUA_METHOD(LuaMethodTester, Join, const char*, LuaVarArgs),
+    LUA_METHOD(LuaMethodTester, Describe, LuaVarArgs),
+    LUA_OVERLOADS(LuaMethodTester, Log, std::string(int), std::string(const char*, LuaVarArgs)),
+    LUA_OVERLOADS(LuaMethodTester, Set, std::string(const char*), std::string(const char*, int),
+                  std::string(const char*, const char*) const, std::string(const char*, bool),
+                  std::string(const char*, LuaVariant)),
+    LUA_METHOD(LuaMethodTester, TupleTester, void),
+    LUA_OVERLOADS(LuaMethodTester, Where, std::string(lua_State*, const char*) const,
+                  std::string(lua_State*, int) const),
+    LUA_METHOD(LuaMethodTester, YieldPair, Lua&, int),
+    LUA_METHOD(LuaMethodTester, Wait, lua_State*, int),
 };
 
 class LuaMethodTest : public LuaTestBase {
@@ -61,7 +245,7 @@ TEST_F(LuaMethodTest, RecursiveArg) {
         local ok, err = pcall(function() tester:RecursiveArgTester(x) end)
         if ok then
             return false -- expected error
-        elseif not err:match("Max depth reached$") then
+        elseif not err:match("Cycle detected$") then
             print("Unexpected error: " .. err)
             return false
         else
@@ -95,3 +279,269 @@ TEST_F(LuaMethodTest, TooDeepResult) {
     ASSERT_GE(lua_gettop(L), 1);
     EXPECT_TRUE(lua_toboolean(L, -1));
 }
+
+TEST_F(LuaMethodTest, StringView) {
+    ASSERT_TRUE(doString(R""""(
+        local s = tester:StringViewTester("a\0b")
+        return #s == 4 and s == "a\0b!" and tester:StringViewResultTester() == "a\0b"
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+TEST_F(LuaMethodTest, VariantPassThrough) {
+    ASSERT_TRUE(doString(R""""(
+        local t = {}
+        local f = function() end
+        return tester:VariantTester(t) == t and tester:VariantTester(f) == f and tester:VariantTester(tester) == tester
+            and tester:VariantTester("s") == "s"
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+TEST_F(LuaMethodTest, MultipleResults) {
+    ASSERT_TRUE(doString(R""""(
+        local x, y = tester:PairTester()
+        local a, b, c, d, e = tester:TupleTester()
+        return select("#", tester:PairTester()) == 2 and x == 1 and y == 2
+            and select("#", tester:TupleTester()) == 5 and a == 3 and b == 0.5 and c == "four" and d == true
+            and e.a == 5
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+TEST_F(LuaMethodTest, Functions) {
+    LuaGlue::newlib(L, {
+        LUA_FUNCTION(add, int, int),
+        LUA_FUNCTION(describe, std::string_view),
+        LUA_STATIC_METHOD(LuaMethodTester, Twice, int),
+    });
+    LuaGlue::setfuncs(L, {
+        LUA_STATIC_METHOD(LuaMethodTester, Nothing, void),
+    });
+    lua_setglobal(L, "mod");
+    ASSERT_TRUE(doString(R""""(
+        local s, n = mod.describe("abc")
+        return mod.add(1, 2) == 3 and s == "abc!" and n == 3 and mod.Twice(4) == 8
+            and select("#", mod.Nothing()) == 0
+    )""""));
+    ASSERT_GE(lua_gettop(L), 1);
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+TEST_F(LuaMethodTest, Overloads) {
+    ASSERT_TRUE(doString(R""""(
+        return tester:Set("a"), tester:Set("a", 1), tester:Set("a", "b"), tester:Set("a", false), tester:Set("a", {})
+    )""""));
+    ASSERT_EQ(lua_gettop(L), 5);
+    EXPECT_STREQ(lua_tostring(L, 1), "Set(a)");
+    EXPECT_STREQ(lua_tostring(L, 2), "Set(a, int 1)");
+    EXPECT_STREQ(lua_tostring(L, 3), "Set(a, string b)");
+    EXPECT_STREQ(lua_tostring(L, 4), "Set(a, bool false)");
+    EXPECT_STREQ(lua_tostring(L, 5), "Set(a, any)");
+}
+
+TEST_F(LuaMethodTest, OverloadsInteger) {
+    // a number with a fraction does not select the int overload, which could not take it
+    ASSERT_TRUE(doString(R""""(
+        return tester:Set("a", 1.5), tester:Set("a", 2)
+    )""""));
+    ASSERT_EQ(lua_gettop(L), 2);
+    EXPECT_STREQ(lua_tostring(L, 1), "Set(a, any)");
+    EXPECT_STREQ(lua_tostring(L, 2), "Set(a, int 2)");
+}
+
+TEST_F(LuaMethodTest, OverloadsNoMatch) {
+    EXPECT_FALSE(doString("tester:Set(1, 2, 3)"));
+    ASSERT_EQ(lua_gettop(L), 1);
+    const std::string err = lua_tostring(L, -1);
+    EXPECT_NE(err.find("No matching overload for Set(number, number, number), candidates: Set(string) "
+                       "Set(string, integer) Set(string, string) Set(string, boolean) Set(string, any)"),
+              std::string::npos) << err;
+}
+
+TEST_F(LuaMethodTest, VarArgs) {
+    ASSERT_TRUE(doString(R""""(
+        return tester:Join(", ", "a", 1, "b"), tester:Join(", "), tester:Describe(), tester:Describe(true, nil, "x")
+    )""""));
+    ASSERT_EQ(lua_gettop(L), 6);
+    EXPECT_STREQ(lua_tostring(L, 1), "a, 1, b");
+    EXPECT_STREQ(lua_tostring(L, 2), "");
+    EXPECT_EQ(lua_tointeger(L, 3), 0);
+    EXPECT_EQ(lua_tointeger(L, 4), 3);
+    EXPECT_EQ(lua_tointeger(L, 5), LUA_TBOOLEAN);
+    EXPECT_STREQ(lua_tostring(L, 6), "\"x\"");
+    lua_settop(L, 0);
+
+    ASSERT_TRUE(doString("return tester:Describe()"));
+    ASSERT_EQ(lua_gettop(L), 3);
+    EXPECT_EQ(lua_tointeger(L, 2), LUA_TNONE);
+    EXPECT_STREQ(lua_tostring(L, 3), "");
+    lua_settop(L, 0);
+
+    EXPECT_FALSE(doString("tester:Join(', ', 'a', {})"));
+    EXPECT_NE(std::string(lua_tostring(L, -1)).find("bad argument #3 to 'Join' (string expected, got table)"),
+              std::string::npos) << lua_tostring(L, -1);
+}
+
+TEST_F(LuaMethodTest, VarArgsView) {
+    lua_pushinteger(L, 1);
+    lua_pushstring(L, "two");
+    lua_pushnumber(L, 3.5);
+    const auto args = LuaVarArgs::FromStack(L, 2);
+    ASSERT_EQ(args.size(), 2u);
+    EXPECT_EQ(args.first(), 2);
+    EXPECT_EQ(args.end() - args.begin(), 2);
+    EXPECT_EQ(args[0].toStringView(), "two");
+    EXPECT_FALSE(args[1].isInteger());
+    EXPECT_EQ(args[1].toNumber(), 3.5);
+    EXPECT_EQ(args[0].tryStringView().value(), "two");
+    EXPECT_STREQ(args[0].tryCString().value(), "two");
+    EXPECT_EQ(args[1].tryNumber().value(), 3.5);
+    EXPECT_EQ(args[0].tryInteger().error(), "bad argument #2 (number expected, got string)");
+    EXPECT_TRUE(LuaVarArgs(L, 4, 0).empty());
+
+    args.Lua_Push(L);
+    ASSERT_EQ(lua_gettop(L), 5);
+    EXPECT_STREQ(lua_tostring(L, 4), "two");
+    EXPECT_EQ(lua_tonumber(L, 5), 3.5);
+}
+
+TEST_F(LuaMethodTest, VarArgsIterator) {
+    for (int i = 1; i <= 4; i++)
+        lua_pushinteger(L, 2 * i);
+    const auto args = LuaVarArgs::FromStack(L, 1);
+    const auto found = std::lower_bound(args.begin(), args.end(), 5, [](const LuaVarArgs::Arg& arg, int value) {
+        return arg.toInteger() < value;
+    });
+    EXPECT_EQ(found - args.begin(), 2);
+    EXPECT_EQ((*found).toInteger(), 6);
+    EXPECT_TRUE(found == 2 + args.begin());
+    EXPECT_TRUE(found > args.begin() && found >= args.begin() + 2 && found <= args.end() && !(found > args.end()));
+    EXPECT_EQ(std::prev(args.end())[-1].toInteger(), 6);
+}
+
+TEST_F(LuaMethodTest, OverloadsVarArgs) {
+    ASSERT_TRUE(doString(R""""(
+        return tester:Log(1), tester:Log("x"), tester:Log("x", 1, 2)
+    )""""));
+    ASSERT_EQ(lua_gettop(L), 3);
+    EXPECT_STREQ(lua_tostring(L, 1), "level 1");
+    EXPECT_STREQ(lua_tostring(L, 2), "x with 0");
+    EXPECT_STREQ(lua_tostring(L, 3), "x with 2");
+    lua_settop(L, 0);
+
+    EXPECT_FALSE(doString("tester:Log()"));
+    EXPECT_NE(std::string(lua_tostring(L, -1)).find("candidates: Log(integer) Log(string, ...)"), std::string::npos)
+            << lua_tostring(L, -1);
+}
+
+TEST_F(LuaMethodTest, Results) {
+    ASSERT_TRUE(doString(R""""(
+        local a, b = tester:CheckedPair(3)
+        return tester:Checked(2), a, b, select("#", tester:CheckedVoid(true))
+    )""""));
+    ASSERT_EQ(lua_gettop(L), 4);
+    EXPECT_EQ(lua_tointeger(L, 1), 4);
+    EXPECT_EQ(lua_tointeger(L, 2), 3);
+    EXPECT_STREQ(lua_tostring(L, 3), "ok");
+    EXPECT_EQ(lua_tointeger(L, 4), 0);
+    lua_settop(L, 0);
+
+    ASSERT_TRUE(doString(R""""(
+        local ok1, err1 = pcall(tester.Checked, tester, -1)
+        local ok2, err2 = pcall(tester.CheckedPair, tester, -1)
+        local ok3, err3 = pcall(tester.CheckedVoid, tester, false)
+        return ok1 or ok2 or ok3, err1, err2, err3
+    )""""));
+    EXPECT_FALSE(lua_toboolean(L, 1));
+    EXPECT_STREQ(lua_tostring(L, 2), "negative value -1");
+    EXPECT_STREQ(lua_tostring(L, 3), "negative");
+    EXPECT_STREQ(lua_tostring(L, 4), "failed");
+}
+
+TEST_F(LuaMethodTest, ArgErrors) {
+    EXPECT_FALSE(doString("tester:Checked('x')"));
+    EXPECT_NE(std::string(lua_tostring(L, -1)).find("bad argument #1 to 'Checked' (number expected, got string)"),
+              std::string::npos) << lua_tostring(L, -1);
+    lua_settop(L, 0);
+#if LUA_VERSION_NUM >= 503
+    EXPECT_FALSE(doString("tester:Checked(1.5)"));
+    EXPECT_NE(std::string(lua_tostring(L, -1)).find("number has no integer representation"), std::string::npos)
+            << lua_tostring(L, -1);
+    lua_settop(L, 0);
+#endif
+    EXPECT_FALSE(doString("tester:StringViewTester()"));
+    EXPECT_NE(std::string(lua_tostring(L, -1)).find("string expected, got no value"), std::string::npos)
+            << lua_tostring(L, -1);
+}
+
+TEST_F(LuaMethodTest, ArgErrorReleasesArgs) {
+    // the LuaVariant holding the table has to be destroyed before the error is raised, otherwise it stays referenced
+    ASSERT_TRUE(doString(R""""(
+        local weak = setmetatable({}, {__mode = "v"})
+        weak[1] = {}
+        local ok = pcall(tester.VariantThenInt, tester, weak[1], "x")
+        collectgarbage()
+        collectgarbage()
+        return ok, weak[1] == nil
+    )""""));
+    EXPECT_FALSE(lua_toboolean(L, 1));
+    EXPECT_TRUE(lua_toboolean(L, 2));
+}
+
+TEST_F(LuaMethodTest, StateArg) {
+    ASSERT_TRUE(doString("return tester:Where('a'), tester:Where(1)"));
+    ASSERT_EQ(lua_gettop(L), 2);
+    EXPECT_STREQ(lua_tostring(L, 1), "a main");
+    EXPECT_STREQ(lua_tostring(L, 2), "1 main");
+    lua_settop(L, 0);
+    lua_State *co = lua_newthread(L);
+    ASSERT_EQ(luaL_loadstring(co, "return tester:Where('b')"), LUA_OK);
+    int nres;
+    ASSERT_EQ(lua_resume(co, L, 0, &nres), LUA_OK);
+    ASSERT_EQ(nres, 1);
+    EXPECT_STREQ(lua_tostring(co, -1), "b coroutine");
+    // the lua_State argument is not part of the signature
+    EXPECT_FALSE(doString("tester:Where({})"));
+    const std::string err = lua_tostring(L, -1);
+    EXPECT_NE(err.find("candidates: Where(string) Where(integer)"), std::string::npos) << err;
+}
+
+TEST_F(LuaMethodTest, Yield) {
+    lua_State *co = lua_newthread(L);
+    ASSERT_EQ(luaL_loadstring(co, R""""(
+        local a, b = tester:YieldPair(1)
+        local r = tester:Wait(7)
+        return a + b, r
+    )""""), LUA_OK);
+    int nres;
+    // values pushed by YieldPair
+    ASSERT_EQ(lua_resume(co, L, 0, &nres), LUA_YIELD);
+    ASSERT_EQ(nres, 2);
+    EXPECT_EQ(lua_tointeger(co, -2), 1);
+    EXPECT_EQ(lua_tointeger(co, -1), 2);
+    lua_pop(co, nres);
+    // values passed to resume are the results of YieldPair
+    lua_pushinteger(co, 3);
+    lua_pushinteger(co, 4);
+    ASSERT_EQ(lua_resume(co, L, 2, &nres), LUA_YIELD);
+    EXPECT_EQ(nres, 0);
+    EXPECT_EQ(tester._waiting, co);
+    EXPECT_EQ(tester._waitId, 7);
+    // later
+    lua_pushstring(co, "done");
+    ASSERT_EQ(lua_resume(co, L, 1, &nres), LUA_OK);
+    ASSERT_EQ(nres, 2);
+    EXPECT_EQ(lua_tointeger(co, -2), 7);
+    EXPECT_STREQ(lua_tostring(co, -1), "done");
+}
+
+TEST_F(LuaMethodTest, YieldOutsideCoroutine) {
+    EXPECT_FALSE(doString("tester:Wait(1)"));
+    const std::string err = lua_tostring(L, -1);
+    EXPECT_NE(err.find("attempt to yield from outside a coroutine"), std::string::npos) << err;
+    EXPECT_EQ(tester._waiting, L); // the method itself was called
+}
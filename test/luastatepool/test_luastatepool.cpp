@@ -0,0 +1,172 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "../luatestbase.hpp"
+#include "../macros.hpp"
+#include "../../luainterface.h"
+#include "../../luamethod.h"
+#include "../../luastatepool.h"
+
+
+// ReSharper disable CppMemberFunctionMayBeStatic
+class LuaStatePoolTester : public LuaInterface<LuaStatePoolTester> {
+    friend class LuaInterface;
+
+public:
+    int Twice(int a) const
+    {
+        return 2 * a;
+    }
+
+protected: // Lua interface implementation
+    static constexpr char Lua_Name[] = "LuaStatePoolTester";
+    static constexpr auto Lua_Methods = MakeMethodMap({
+        LUA_METHOD(LuaStatePoolTester, Twice, int),
+    });
+};
+
+enum class LuaStatePoolColor {
+    Red = 1,
+    Green = 2,
+};
+
+static LuaManifest testManifest()
+{
+    LuaManifest manifest;
+    manifest.OpenLibs()
+            .Register<LuaStatePoolTester>(LuaStatePoolTester::IndexMode::MethodTable)
+            .Enum("Color", LuaEnum<LuaStatePoolColor>({
+                {"Red", LuaStatePoolColor::Red},
+                {"Green", LuaStatePoolColor::Green},
+            }))
+            .Global("NAME", "pool")
+            .Global("COUNT", 3)
+            .Call([](lua_State *L) {
+                // instance owned by each state
+                LuaStatePoolTester::Lua_New(L);
+                lua_setglobal(L, "tester");
+            });
+    return manifest;
+}
+
+static bool runScript(lua_State *L, const char* s)
+{
+    const bool res = luaL_dostring(L, s) == LUA_OK;
+    if (!res)
+        printf("%s\n", lua_tostring(L, -1));
+    lua_settop(L, 0);
+    return res;
+}
+
+static const char* const checkSetup =
+        "assert(NAME == 'pool' and COUNT == 3)\n"
+        "assert(Color.Red == 1 and Color.Green == 2)\n"
+        "assert(tester:Twice(COUNT) == 6)\n"
+        "assert(string.rep('a', 2) == 'aa')\n";
+
+TEST(LuaManifestTest, NewState) {
+    const LuaManifest manifest = testManifest();
+    EXPECT_EQ(manifest.size(), 6u);
+    lua_State *L = manifest.NewState();
+    ASSERT_NE(L, nullptr);
+    EXPECT_EQ(lua_gettop(L), 0);
+    EXPECT_TRUE(runScript(L, checkSetup));
+    lua_close(L);
+}
+
+TEST(LuaManifestTest, Error) {
+    LuaManifest manifest;
+    std::vector<int> steps;
+    manifest.Call([&steps](lua_State *) { steps.push_back(1); })
+            .Call([](lua_State *L) { luaL_error(L, "setup failed"); })
+            .Call([&steps](lua_State *) { steps.push_back(3); });
+    std::string error;
+    EXPECT_EQ(manifest.NewState(&error), nullptr);
+    EXPECT_NE(error.find("setup failed"), error.npos);
+    EXPECT_EQ(steps, std::vector<int>{1});
+}
+
+TEST(LuaManifestTest, ApplyKeepsStack) {
+    LuaManifest manifest;
+    manifest.Global("X", 1);
+    lua_State *L = luaL_newstate();
+    lua_pushinteger(L, 42);
+    EXPECT_TRUE(manifest.Apply(L));
+    EXPECT_EQ(lua_gettop(L), 1);
+    EXPECT_EQ(lua_tointeger(L, 1), 42);
+    lua_close(L);
+}
+
+TEST(LuaStatePoolTest, Create) {
+    LuaStatePool pool(testManifest(), 4, 2);
+    EXPECT_EQ(pool.size(), 4u);
+    EXPECT_EQ(pool.available(), 4u);
+    EXPECT_TRUE(pool.error().empty());
+    std::vector<LuaStatePool::Handle> handles;
+    for (int i = 0; i < 4; i++) {
+        handles.push_back(pool.TryCheckout());
+        ASSERT_TRUE(handles.back());
+        EXPECT_TRUE(runScript(handles.back(), checkSetup));
+    }
+    EXPECT_EQ(pool.available(), 0u);
+    EXPECT_FALSE(pool.TryCheckout());
+    // all states are different
+    for (size_t i = 0; i < handles.size(); i++)
+        for (size_t j = i + 1; j < handles.size(); j++)
+            EXPECT_NE(handles[i].get(), handles[j].get());
+    handles.clear();
+    EXPECT_EQ(pool.available(), 4u);
+}
+
+TEST(LuaStatePoolTest, FailedStates) {
+    LuaManifest manifest;
+    manifest.Call([](lua_State *L) { luaL_error(L, "setup failed"); });
+    LuaStatePool pool(std::move(manifest), 3);
+    EXPECT_EQ(pool.size(), 0u);
+    EXPECT_NE(pool.error().find("setup failed"), std::string::npos);
+    EXPECT_FALSE(pool.Checkout());
+}
+
+TEST(LuaStatePoolTest, ReturnAndDiscard) {
+    LuaStatePool pool(testManifest(), 1);
+    {
+        auto L = pool.Checkout();
+        ASSERT_TRUE(L);
+        lua_pushinteger(L, 1); // stack is cleared on return
+        EXPECT_TRUE(runScript(L, "LEFTOVER = true"));
+        lua_pushinteger(L, 1);
+    }
+    {
+        auto L = pool.Checkout();
+        EXPECT_EQ(lua_gettop(L), 0);
+        EXPECT_TRUE(runScript(L, "assert(LEFTOVER == true)"));
+        L.Discard();
+    }
+    {
+        auto L = pool.Checkout();
+        EXPECT_TRUE(runScript(L, "assert(LEFTOVER == nil)"));
+        EXPECT_TRUE(runScript(L, checkSetup));
+        L.Return();
+        EXPECT_FALSE(L);
+        EXPECT_EQ(pool.available(), 1u);
+    }
+}
+
+TEST(LuaStatePoolTest, Threads) {
+    LuaStatePool pool(testManifest(), 2);
+    std::atomic<int> ok{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&pool, &ok]() {
+            for (int i = 0; i < 50; i++) {
+                auto L = pool.Checkout();
+                if (L && runScript(L, "local n = 0; for i = 1, 100 do n = n + tester:Twice(i) end; assert(n == 10100)"))
+                    ok++;
+            }
+        });
+    }
+    for (auto& thread: threads)
+        thread.join();
+    EXPECT_EQ(ok, 200);
+    EXPECT_EQ(pool.available(), 2u);
+}
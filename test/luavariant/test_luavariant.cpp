@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../luatestbase.hpp"
+#include "../../luavariant.h"
+
+
+class LuaVariantTest : public LuaTestBase {
+protected:
+    const std::string longString = std::string(LuaVariant::InlineSize + 10, 'x') + std::string("\0y", 2);
+
+    LuaVariant get(const int i, const bool borrow = false)
+    {
+        LuaVariant v;
+        if (borrow)
+            EXPECT_TRUE(v.Lua_Borrow(L, i));
+        else
+            EXPECT_TRUE(v.Lua_Get(L, i));
+        return v;
+    }
+};
+
+TEST_F(LuaVariantTest, Compact) {
+    EXPECT_LE(sizeof(LuaVariant), 4 * sizeof(void*));
+}
+
+TEST_F(LuaVariantTest, Scalars) {
+    lua_pushinteger(L, 3);
+    lua_pushnumber(L, 1.5);
+    lua_pushboolean(L, 1);
+    lua_pushnil(L);
+    EXPECT_EQ(get(1).toString(), "3");
+    EXPECT_EQ(get(2).toString(), std::to_string(1.5));
+    EXPECT_TRUE(get(3).isTrue());
+    EXPECT_EQ(get(4).toString(), "nil");
+    EXPECT_FALSE(get(1) == get(2));
+    EXPECT_TRUE(get(4) == get(4));
+    LuaVariant none;
+    EXPECT_FALSE(none.Lua_Get(L, 5));
+}
+
+TEST_F(LuaVariantTest, Strings) {
+    lua_pushlstring(L, "a\0b", 3);
+    lua_pushlstring(L, longString.data(), longString.size());
+    const LuaVariant small = get(1);
+    const LuaVariant large = get(2);
+    EXPECT_EQ(small.stringView(), std::string_view("a\0b", 3));
+    EXPECT_EQ(large.stringView(), longString);
+    EXPECT_FALSE(large.isBorrowed());
+    EXPECT_EQ(small.toString(), std::string("\"a\0b\"", 5));
+    EXPECT_TRUE(large == get(2, true));
+    EXPECT_FALSE(small == large);
+
+    lua_settop(L, 0);
+    large.Lua_Push(L);
+    size_t len;
+    const char* s = lua_tolstring(L, -1, &len);
+    EXPECT_EQ(std::string(s, len), longString);
+}
+
+TEST_F(LuaVariantTest, Borrow) {
+    lua_pushlstring(L, longString.data(), longString.size());
+    LuaVariant v = get(1, true);
+    EXPECT_TRUE(v.isBorrowed());
+    EXPECT_EQ(v.stringView().data(), lua_tostring(L, 1));
+    LuaVariant copy = v; // still borrowed
+    EXPECT_TRUE(copy.isBorrowed());
+    v.own();
+    EXPECT_FALSE(v.isBorrowed());
+    EXPECT_NE(v.stringView().data(), lua_tostring(L, 1));
+    EXPECT_TRUE(v == copy);
+    copy.own();
+    lua_settop(L, 0);
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    EXPECT_EQ(v.stringView(), longString);
+    EXPECT_EQ(copy.stringView(), longString);
+
+    // small strings are always inline
+    lua_pushstring(L, "abc");
+    EXPECT_FALSE(get(1, true).isBorrowed());
+}
+
+TEST_F(LuaVariantTest, CopyAndMove) {
+    lua_pushlstring(L, longString.data(), longString.size());
+    lua_pushstring(L, "small");
+    std::vector<LuaVariant> values;
+    for (int n = 0; n < 10; n++) {
+        values.push_back(get(1));
+        values.push_back(get(2));
+    }
+    lua_settop(L, 0);
+    std::vector<LuaVariant> copies = values;
+    std::vector<LuaVariant> moved = std::move(values);
+    for (size_t i = 0; i < moved.size(); i++) {
+        EXPECT_TRUE(moved[i] == copies[i]);
+        EXPECT_EQ(moved[i].stringView(), i % 2 ? "small" : longString);
+    }
+    copies[0] = copies[1];
+    EXPECT_EQ(copies[0].stringView(), "small");
+    copies[1] = std::move(moved[0]);
+    EXPECT_EQ(copies[1].stringView(), longString);
+}
+
+TEST_F(LuaVariantTest, Objects) {
+    ASSERT_TRUE(doString(R""""(
+        return {1, 2}, function() return 3 end, coroutine and coroutine.create(function() end) or {}
+    )""""));
+    lua_pushlightuserdata(L, this);
+    for (int i = 1; i <= 4; i++) {
+        const LuaVariant v = get(i);
+        const LuaVariant copy = v;
+        EXPECT_TRUE(v == copy);
+        EXPECT_FALSE(v == get(i % 4 + 1));
+        // pushes the same object back
+        copy.Lua_Push(L);
+        EXPECT_TRUE(lua_rawequal(L, i, -1));
+        lua_pop(L, 1);
+        // same as tostring()
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%s: %p", luaL_typename(L, i), lua_topointer(L, i));
+        EXPECT_EQ(v.toString(), buf);
+    }
+    EXPECT_EQ(lua_gettop(L), 4);
+}
+
+TEST_F(LuaVariantTest, ObjectRefs) {
+    // the object is kept alive by the variant and its copies, and released when the last one is gone
+    ASSERT_TRUE(doString(R""""(
+        weak = setmetatable({}, {__mode = "v"})
+        weak[1] = {"value"}
+        return weak[1]
+    )""""));
+    std::vector<LuaVariant> values;
+    values.push_back(get(1));
+    lua_settop(L, 0);
+    values.push_back(values[0]);
+    LuaVariant moved = std::move(values[0]);
+    values.clear();
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    ASSERT_TRUE(doString("return weak[1] ~= nil"));
+    EXPECT_TRUE(lua_toboolean(L, -1));
+
+    lua_settop(L, 0);
+    moved.Lua_Push(L);
+    lua_rawgeti(L, -1, 1);
+    EXPECT_STREQ(lua_tostring(L, -1), "value");
+    lua_settop(L, 0);
+    moved = LuaVariant();
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    ASSERT_TRUE(doString("return weak[1] == nil"));
+    EXPECT_TRUE(lua_toboolean(L, -1));
+}
+
+TEST_F(LuaVariantTest, Coroutine) {
+    // fetched on a coroutine that is collected before the variants are copied, compared and released
+    lua_State* co = lua_newthread(L);
+    lua_newtable(co);
+    std::vector<LuaVariant> values(1);
+    ASSERT_TRUE(values[0].Lua_Get(co, -1));
+    lua_settop(L, 0);
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    values.push_back(values[0]);
+    EXPECT_TRUE(values[0] == values[1]);
+    EXPECT_EQ(values[1].toString().compare(0, 7, "table: "), 0) << values[1].toString();
+    values[1].Lua_Push(L);
+    EXPECT_EQ(lua_type(L, -1), LUA_TTABLE);
+    values.clear();
+    lua_settop(L, 0);
+
+    // copied, compared and released inside a coroutine, while the main thread is in lua_resume
+    co = lua_newthread(L);
+    lua_pushcfunction(co, [](lua_State* L) {
+        LuaVariant v;
+        v.Lua_Get(L, 1);
+        const LuaVariant copy = v;
+        lua_pushboolean(L, copy == v && copy.toString() == v.toString());
+        copy.Lua_Push(L);
+        return 2;
+    });
+    lua_newtable(co);
+    lua_pushvalue(co, -1);
+    lua_xmove(co, L, 1);
+    int nres;
+    ASSERT_EQ(lua_resume(co, L, 1, &nres), 0);
+    ASSERT_EQ(nres, 2);
+    EXPECT_TRUE(lua_toboolean(co, 1));
+    lua_xmove(co, L, 1);
+    EXPECT_TRUE(lua_rawequal(L, -1, -2));
+}
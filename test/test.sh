@@ -1,6 +1,17 @@
 #!/bin/sh
 set -e
 
+# LUA_VERSION can be a list of pkg-config names, e.g. "lua5.4 lua5.1 luajit", to test all of them
+case "$LUA_VERSION" in
+  *" "*)
+    for v in $LUA_VERSION; do
+      printf "\n%s\n" "Testing $v"
+      LUA_VERSION="$v" sh "$0" || exit 1
+    done
+    exit 0
+    ;;
+esac
+
 RED="\e[0;31m"
 GREEN="\e[0;32m"
 NORMAL="\e[0m"
@@ -9,7 +20,7 @@ if [ -z "$CXX" ]; then
   CXX="g++"
 fi
 
-LIBS="-lgtest_main -lgtest"
+LIBS="-lgtest_main -lgtest -lpthread"
 if [ "$LUA_VERSION" != "" ]; then
   LIBS="$LIBS $(pkg-config --cflags --libs "$LUA_VERSION")"
 else
@@ -17,16 +28,25 @@ else
 fi
 WARN_FLAGS="-Wall -Wextra -Werror -Wno-unused-function"
 TEST_DIR="$(dirname "$0")"
-TEST_FILES="$TEST_DIR/*/*.cpp"
+TEST_FILES="$(find "$TEST_DIR" -mindepth 2 -maxdepth 2 -name "*.cpp" -not -path "*/bench/*" -not -path "*/cpp14/*")"
+TEST_FILES_CPP14="$(find "$TEST_DIR/cpp14" -name "*.cpp")"
 TEST_BUILD_DIR="$TEST_DIR/build"
 TEST_EXE="$TEST_BUILD_DIR/test"
 TEST_EXE_NO_EX="$TEST_BUILD_DIR/test-no-exceptions"
+TEST_EXE_LONG="$TEST_BUILD_DIR/test-long-form"
+TEST_EXE_CPP14="$TEST_BUILD_DIR/test-cpp14"
 
 mkdir -p "$TEST_BUILD_DIR"
 # shellcheck disable=SC2086
 "$CXX" -o "$TEST_EXE" $TEST_FILES $LIBS $WARN_FLAGS
 # shellcheck disable=SC2086
 "$CXX" -o "$TEST_EXE_NO_EX" $TEST_FILES $LIBS $WARN_FLAGS -fno-exceptions
+# the same tests through _luamethod.14.h, which is otherwise only used by C++14 builds
+# shellcheck disable=SC2086
+"$CXX" -o "$TEST_EXE_LONG" $TEST_FILES $LIBS $WARN_FLAGS -DLUA_METHOD_LONG_FORM
+# luamethod.h without the C++17 headers, e.g. luainterface.h
+# shellcheck disable=SC2086
+"$CXX" -o "$TEST_EXE_CPP14" $TEST_FILES_CPP14 $LIBS $WARN_FLAGS -std=c++14
 
 set +e
 printf "%s ${GREEN}%s${NORMAL}\n" "Testing with exceptions" "ON"
@@ -35,10 +55,16 @@ OK_EX=$?
 printf "\n%s ${RED}%s${NORMAL}\n" "Testing with exceptions" "OFF"
 "$TEST_EXE_NO_EX"
 OK_NO_EX=$?
+printf "\n%s\n" "Testing LUA_METHOD_LONG_FORM"
+"$TEST_EXE_LONG"
+OK_LONG=$?
+printf "\n%s\n" "Testing C++14"
+"$TEST_EXE_CPP14"
+OK_CPP14=$?
 set -e
 
 printf "\n"
-if [ $OK_EX -eq 0 ] && [ $OK_NO_EX -eq 0 ]; then
+if [ $OK_EX -eq 0 ] && [ $OK_NO_EX -eq 0 ] && [ $OK_LONG -eq 0 ] && [ $OK_CPP14 -eq 0 ]; then
   printf "${GREEN}%s${NORMAL}\n" "All tests passed!"
 else
   if [ $OK_EX -ne 0 ]; then
@@ -47,5 +73,11 @@ else
   if [ $OK_NO_EX -ne 0 ]; then
     printf "${RED}%s${NORMAL}\n" "Some no-exceptions tests failed!" >&2
   fi
+  if [ $OK_LONG -ne 0 ]; then
+    printf "${RED}%s${NORMAL}\n" "Some long form tests failed!" >&2
+  fi
+  if [ $OK_CPP14 -ne 0 ]; then
+    printf "${RED}%s${NORMAL}\n" "Some C++14 tests failed!" >&2
+  fi
   exit 1
 fi